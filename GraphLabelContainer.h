@@ -5,7 +5,19 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <iterator>
+#include <array>
 #include "SingleDLS.h"
+#include "LabelBitmap.h"
+#include "SortedSets.h"
+#include "LabelExpression.h"
+#include "LabelFile.h"
+#include "LabelDelta.h"
+#include <functional>
+#include <mutex>
+#include <random>
+#include <unordered_set>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 /*!
@@ -31,15 +43,177 @@
 /// Recycling is a FIFO vector - where when a pair index is removed then its id is recycled for the new possible labels combo set
 /// m_maxid is incremented when the recycle que is empty as an id factory.
 ///
+/// An optional is-a hierarchy (DAG) can be registered over the label indexes, e.g., vp and ceo are kinds of executive.
+/// For each label that has sub-labels, the closure of pair indexes whose label set contains the label or any of its
+/// descendants is kept sorted in m_label2closure and maintained as pair indexes are created and recycled, so that
+/// a hierarchical label query costs the same as a flat one --> See getSubsumedEntities
+///
+/// A label co-occurrence graph (ontology) weighted by entity counts is maintained from the per pair index counts of
+/// the SingleDLS. Moving an entity only marks its old/new pair indexes dirty; the label x label weights are then
+/// brought up to date for the dirty indexes alone when the graph is fetched --> See getCooccurrence
+///
+/// Threading: the const member functions may be called concurrently, the state they bring up to date lazily is
+/// guarded by m_sync; the other member functions need exclusive access to the container.
+///
+/// Entities can be renumbered so that the ones sharing a pair index get consecutive ids for locality, the permutation
+/// is returned so the host graph can reorder its own arrays --> See renumber
+/// Afterwards, the consecutive entity runs of each pair index can be stored as intervals instead of chains --> See compact
+///
+/// Label query results can also be produced as compressed bitmaps (see LabelBitmap.h) for set algebra with traversal
+/// frontiers or SQL filters. Bitmaps of hot labels can be cached; a cached bitmap is dropped when an entity moves
+/// in or out of any pair index of its label.
+///
+/// Label transitions (pair index, +label/-label) --> pair index are memoized in m_transitions so that adding the same
+/// label to many entities resolves the new labels set once per pair index; an entry is dropped when its source pair
+/// index is recycled and ignored when its target was recycled since (generation mismatch). The batch addLabel/delLabel
+/// group the entities by pair index and move each group chain to chain in bulk.
+///
+/// The sorted label/pair index arrays are merged, intersected and tested with the kernels of SortedSets.h.
+///
+/// Standing (continuous) label queries: a registered label expression is evaluated once per pair index when the index
+/// is created. When an entity moves between two pair indexes whose match status differs, an enter/leave delta is
+/// buffered for the query and its running count and result bitmap are updated; no rescans. Only labeled entities
+/// are covered, i.e., an expression like !label never matches entities without any label.
+///
+/// Random samples and first page previews of a label's entities are drawn without expanding the label: the drawn
+/// positions are located in the pair indexes by their maintained entity counts and in the posting bitmaps by their
+/// container cardinalities. The exact mode walks each chain from its head up to the last drawn position; the fast
+/// mode starts each lookup from the nearest skip point of the chain --> See sampleEntities
+///
+/// Replicas and shards are synchronized with deltas: diff records the changed entities as runs over a dictionary of
+/// their new labels sets, apply maps that dictionary to the local pair indexes and moves the entities --> See diff
+///
+/// Move listeners are notified of every entity move so that companion indexes stay in sync --> See addMoveListener
+///
+/// The labels of a batch of entities (e.g., a traversal result) are projected per tuple: each distinct labels set is
+/// returned once with a tuple id per entity instead of a labels vector copy per entity --> See projectLabels
+///
+/// When many labels are spread independently over the entities, nearly every entity gets its own labels set and the
+/// tuples stop being shared. Such labels can be moved out of the tuples into posting labels, each keeping its entities
+/// in a bitmap; the label queries merge the two transparently. With an adaptive TuplePolicy the most spread labels
+/// are moved once the tuple/entity ratio exceeds it --> See adaptTuples. The co-occurrence weights of the posting
+/// labels are counted over the posted entities when the graph is fetched. The is-a closures, the standing queries and
+/// the companion indexes fed by the move listeners cover the tupled labels only.
+///
+/// Besides the stream write/read, the container can be saved to a chunked file whose entity blocks are encoded,
+/// checksummed and written/read in parallel; entity ranges can be read from it without loading --> See writeFile
+///
 /// Author: Karamete - Aug, 2023
 /// //////////////////////////////////////////////////////////////////////////////////////////////
 */
 class GraphLabelContainer {
+public:
+    enum : std::size_t
+    {
+        FORMAT_MARKER  = 0x474c43464d544c42ull, //- not a plausible labels sets count; tells the stream from the legacy one
+        FORMAT_VERSION = 1                      //- 1: posting labels section
+    };
+
 protected:
     
     std::map<std::vector<std::size_t>, std::size_t > m_labels2index; //- map btw labels set to a unique pair index
     std::vector<std::vector<std::size_t>>            m_index2labels; //- inverse of above
     std::vector<std::vector<std::size_t>>            m_label2indexes;//- book-keeping which indexes each label appears
+
+    std::vector<std::vector<std::size_t>>            m_parents;       //- is-a hierarchy; direct parent labels of each label
+    std::vector<std::vector<std::size_t>>            m_subsumers;     //- labels whose closure includes the indexes of each label
+    std::vector<std::vector<std::size_t>>            m_label2closure; //- indexes of each label and of all its descendants
+
+    mutable std::vector<std::map<std::size_t, std::size_t>> m_cooc;     //- label --> (label >= itself --> number of entities having both)
+    mutable std::vector<std::size_t>                 m_cooc_counts;  //- entity count of each pair index last accounted in m_cooc
+    mutable std::vector<std::size_t>                 m_cooc_dirty;   //- pair indexes whose count changed since last accounted
+    mutable std::vector<char>                        m_cooc_flags;   //- dirty flag of each pair index
+
+    //! A mutex that is not shared by copies of the container
+    struct SyncMutex
+    {
+        std::mutex mutex;
+
+        SyncMutex() {}
+        SyncMutex(const SyncMutex &) {}
+        SyncMutex &operator=(const SyncMutex &) { return *this; }
+    };
+    mutable SyncMutex                                m_sync;         //- guards the lazy updates of the const member functions
+
+    mutable std::map<std::size_t, LabelBitmap>       m_bitmaps;      //- cached entity bitmaps of hot labels; const access holds m_sync
+
+    std::map<std::pair<std::size_t, std::size_t>, std::pair<std::size_t, std::size_t>> m_transitions; //- (index, 2*label+del) --> (index, generation)
+    std::vector<std::size_t>                         m_generations;  //- number of times each pair index is recycled
+
+public:
+    typedef std::function<void(std::size_t, const std::vector<LabelQueryDelta>&)> QuerySubscriber; //- (query id, deltas)
+    typedef std::function<void(const std::size_t*, std::size_t, std::size_t, std::size_t)> MoveListener; //- (gvs, number of gvs, old index, new index)
+
+protected:
+    struct StandingQuery
+    {
+        LabelExpression              expr;
+        QuerySubscriber              subscriber;
+        bool                         active;
+        std::vector<char>            matches; //- match status of each pair index
+        std::size_t                  count;   //- number of entities in the result
+        LabelBitmap                  result;
+        std::vector<LabelQueryDelta> deltas;  //- buffered changes since the last drain/flush
+    };
+    std::vector<StandingQuery>                       m_queries;      //- standing label queries; position is the query id
+    std::vector<MoveListener>                        m_listeners;    //- called after entities moved; an empty function is unregistered
+
+public:
+    //! Adaptive mode: when the pair indexes per entity id exceed max_ratio (with at least min_entities), the labels most
+    //! spread over the pair indexes (in at least min_indexes of them) are turned into posting labels until the ratio is met
+    struct TuplePolicy
+    {
+        bool        adaptive;
+        double      max_ratio;
+        std::size_t min_entities;
+        std::size_t min_indexes;
+
+        TuplePolicy() : adaptive(false), max_ratio(0.25), min_entities(1024), min_indexes(16) {}
+    };
+
+    struct TupleStats
+    {
+        std::size_t entities;         //- entity id range of the pair index chains
+        std::size_t tuples;           //- pair indexes (labels sets) in use
+        double      ratio;            //- tuples per entity
+        double      labels_per_tuple; //- average labels set size
+        std::size_t posting_labels;
+        std::size_t posting_entries;  //- entity memberships kept in the postings
+    };
+
+    //! Labels of a batch of entities grouped by labels set (tuple) --> See projectLabels
+    struct LabelProjection
+    {
+        std::vector<std::size_t> tuple_ids;     //- tuple id of each entity, 0 if it has no labels
+        std::vector<std::size_t> pair_indexes;  //- pair index of (the tupled labels of) tuple id t at [t-1]
+        std::vector<std::size_t> tuple_offsets; //- labels of tuple id t are tuple_labels[tuple_offsets[t-1] .. tuple_offsets[t])
+        std::vector<std::size_t> tuple_labels;
+        std::vector<std::size_t> offsets;       //- CSR on request: labels of entity i are labels[offsets[i] .. offsets[i+1])
+        std::vector<std::size_t> labels;
+
+        void clear()
+        {
+            tuple_ids.clear();
+            pair_indexes.clear();
+            tuple_offsets.assign(1, 0);
+            tuple_labels.clear();
+            offsets.clear();
+            labels.clear();
+        }
+
+        std::size_t size_tuples() const
+        {
+            return pair_indexes.size();
+        }
+    };
+
+protected:
+    TuplePolicy                                      m_policy;
+    std::size_t                                      m_next_check;   //- number of pair indexes to check the policy again at
+    std::vector<char>                                m_posting;      //- posting flag of each label
+    std::vector<std::size_t>                         m_posting_labels; //- sorted posting labels
+    std::vector<LabelBitmap>                         m_postings;     //- entities of each posting label
+    std::unordered_map<std::size_t, std::vector<std::size_t>> m_posted; //- sorted posting labels of each entity having any
     
     SingleDLS m_dls; //- associations between pair indexes and graph entities
     
@@ -61,9 +235,30 @@ protected:
         m_labels2index.clear();
         m_index2labels.clear();
         m_label2indexes.clear();            
+        // the is-a hierarchy is kept; its closures start empty
+        m_label2closure.assign(m_subsumers.size(), std::vector<std::size_t>());
+        m_cooc.clear();
+        m_cooc_counts.clear();
+        m_cooc_dirty.clear();
+        m_cooc_flags.clear();
+        m_bitmaps.clear();
+        m_transitions.clear();
+        m_generations.clear();
+        for(auto &query : m_queries)
+        {
+            query.matches.clear();
+            query.count = 0;
+            query.result.clear();
+            query.deltas.clear();
+        }
         m_dls.clear();
         m_recycle.clear();
         m_maxid = 0;
+        m_next_check = 0;
+        m_posting.clear();
+        m_posting_labels.clear();
+        m_postings.clear();
+        m_posted.clear();
     }
 
     ///! returns the number of items
@@ -98,17 +293,20 @@ protected:
             if(old_index < m_index2labels.size())
             {                
                 const std::vector<std::size_t> &labels = m_index2labels[old_index];
+                syncCooccurrence(old_index);
                 m_labels2index.erase(labels);
                 for(auto label : labels)
                 {
                     if(label < m_label2indexes.size())
-                    {
-                        auto pr = std::find(m_label2indexes[label].begin(), m_label2indexes[label].end(), old_index);
-                        if(pr != m_label2indexes[label].end())
-                            m_label2indexes[label].erase(pr);                       
-                    }                        
+                        SortedSets::erase(m_label2indexes[label], old_index);
                 }                
+                eraseClosure(labels, old_index);
             }
+            // transitions from the old index are dropped; transitions into it become stale
+            m_transitions.erase(m_transitions.lower_bound({old_index, 0}), m_transitions.lower_bound({old_index+1, 0}));
+            if(old_index >= m_generations.size())
+                m_generations.resize(old_index+1, 0);
+            m_generations[old_index]++;
             m_index2labels[old_index].clear();
             if(old_index+1 == m_index2labels.size())
                 m_index2labels.resize(old_index);
@@ -132,10 +330,13 @@ protected:
             {
                 if(label_index >= m_label2indexes.size())
                     m_label2indexes.resize(label_index+1);
-                  m_label2indexes[label_index].insert(std::upper_bound(m_label2indexes[label_index].begin(),  
-                                                                       m_label2indexes[label_index].end(),
-                                                                       pair_index),pair_index);
-                //-m_label2indexes[label_index].push_back(pair_index);
+                SortedSets::insert(m_label2indexes[label_index], pair_index);
+            }
+            insertClosure(newpair, pair_index);
+            for(auto &query : m_queries)
+            {
+                if(query.active)
+                    setMatch(query, pair_index, query.expr.evaluate(newpair));
             }
             if(pair_index >= m_index2labels.size())
             {
@@ -149,100 +350,273 @@ protected:
     //! Adds the label index with a unique pair index and associates the new index (if new) with the entity gv
     std::size_t addLabel(std::size_t gv, std::size_t label_index)
     {        
-        std::size_t pair_index = m_dls.get_label(gv);        
-        std::size_t old_index = pair_index;
-        if(!pair_index)
-            pair_index = addLabel(std::vector<std::size_t>(1,label_index));
-        else
-        {    
-            
-            const std::vector<std::size_t> &existing = m_index2labels[pair_index];
-            if(!std::binary_search(existing.begin(), existing.end(), label_index))
-            {                       
-                std::vector<std::size_t> newpair(existing);            
-                newpair.insert(std::upper_bound(newpair.begin(), newpair.end(), label_index),label_index);               
-                pair_index = addLabel(newpair);
-            }                          
+        std::size_t old_index = m_dls.get_label(gv);        
+        if(isPosting(label_index))
+        {
+            post(gv, label_index);
+            return old_index;
         }
+        std::size_t pair_index = transition(old_index, label_index, false);
        
-        m_dls.insert(gv,pair_index);
+        moveEntity(gv,pair_index);
         
         if(old_index && old_index != pair_index)
         {
             recycle(old_index);
         } 
+        checkTuples();
         return pair_index;
     }
     
     //! IMPORTANT: The label indexes have to be sorted - uses above method for each label in labels
-    std::size_t addLabel(std::size_t gv, const std::vector<std::size_t> &labels)
+    std::size_t addLabel(std::size_t gv, const std::vector<std::size_t> &all_labels)
     {        
         std::size_t pair_index = m_dls.get_label(gv);        
         std::size_t old_index = pair_index;
+        std::vector<std::size_t> tupled;
+        const std::vector<std::size_t> &labels = splitPostings(gv, all_labels, tupled, false) ? tupled : all_labels;
+        if(labels.empty())
+            return pair_index;
         if(!pair_index)
             pair_index = addLabel(labels);
         else
         {                
             const std::vector<std::size_t> &existing = m_index2labels[pair_index];
-            bool nonexists = false;
-            for(auto label : labels)
-            {
-                if(std::find(existing.begin(), existing.end(), label) == existing.end())
-                {
-                    nonexists = true;
-                    break;
-                }                    
-            }
-            if(nonexists)
+            if(!SortedSets::isSubset(labels, existing))
             {                
-                std::vector<std::size_t> newpair(existing);
-                for(auto label : labels)
-                {
-                    newpair.insert(std::upper_bound(newpair.begin(), newpair.end(), label),label);
-                }                             
+                std::vector<std::size_t> newpair;
+                SortedSets::unite(existing, labels, newpair);
                 pair_index = addLabel(newpair);
             }                          
         }
         
-        m_dls.insert(gv,pair_index);
+        moveEntity(gv,pair_index);
         
         if(old_index && old_index != pair_index)
             recycle(old_index);
-        
+        checkTuples();
+        return pair_index;
+    }
+
+    //! Sets the labels set of the entity gv to the sorted labels (empty removes its labels); returns the pair index
+    std::size_t setLabels(std::size_t gv, const std::vector<std::size_t> &all_labels)
+    {
+        std::vector<std::size_t> tupled;
+        const std::vector<std::size_t> &labels = splitPostings(gv, all_labels, tupled, true) ? tupled : all_labels;
+        std::size_t old_index = m_dls.get_label(gv);
+        std::size_t pair_index = labels.empty() ? 0 : addLabel(labels);
+        if(old_index == pair_index)
+            return pair_index;
+        moveEntity(gv, pair_index);
+        if(old_index)
+            recycle(old_index);
+        checkTuples();
         return pair_index;
     }
 
+    //! Registers label_index as a kind of parent_index (is-a); returns false if the relation would create a cycle
+    bool addIsA(std::size_t label_index, std::size_t parent_index)
+    {
+        if(label_index == parent_index || isA(parent_index, label_index))
+            return false;
+        setPostingLabel(label_index, false);
+        setPostingLabel(parent_index, false);
+        std::size_t msize = std::max(label_index, parent_index) + 1;
+        if(msize > m_parents.size())
+            m_parents.resize(msize);
+        std::vector<std::size_t> &parents = m_parents[label_index];
+        auto it = std::lower_bound(parents.begin(), parents.end(), parent_index);
+        if(it != parents.end() && *it == parent_index)
+            return true;
+        parents.insert(it, parent_index);
+        updateHierarchy();
+        return true;
+    }
+
+    //! Clears the is-a hierarchy
+    void clearHierarchy()
+    {
+        m_parents.clear();
+        m_subsumers.clear();
+        m_label2closure.clear();
+    }
+
+    //! Returns true if label_index is parent_index or any of its descendants
+    bool isA(std::size_t label_index, std::size_t parent_index) const
+    {
+        if(label_index == parent_index)
+            return true;
+        if(label_index >= m_parents.size())
+            return false;
+        for(auto parent : m_parents[label_index])
+        {
+            if(isA(parent, parent_index))
+                return true;
+        }
+        return false;
+    }
+
+    //! Returns the label itself and all its descendants (sorted)
+    std::size_t getDescendants(std::size_t label_index, std::vector<std::size_t> &labels) const
+    {
+        labels.clear();
+        for(std::size_t label = 0; label < m_parents.size(); ++label)
+        {
+            if(label != label_index && isA(label, label_index))
+                labels.push_back(label);
+        }
+        labels.insert(std::upper_bound(labels.begin(), labels.end(), label_index), label_index);
+        return labels.size();
+    }
+
+    //! Returns the sorted pair indexes whose labels set contains the label or any of its descendants. Posting labels
+    //! are not in the labels sets of the pair indexes: their entities are only covered by getSubsumedEntities
+    const std::vector<std::size_t> &getSubsumedIndexes(std::size_t label_index) const
+    {
+        static const std::vector<std::size_t> none;
+        if(label_index < m_label2closure.size() && !m_label2closure[label_index].empty())
+            return m_label2closure[label_index];
+        return (label_index < m_label2indexes.size()) ? m_label2indexes[label_index] : none;
+    }
+
+    //! Returns all entities associated with a label index or with any of its descendants in the is-a hierarchy
+    //! (posting labels included)
+    std::size_t getSubsumedEntities(std::size_t label_index, std::vector<std::size_t> &ents, bool clear = true) const
+    {
+        if(clear)
+            ents.clear();
+        // a posting label is kept out of the is-a hierarchy: it subsumes itself only
+        if(isPosting(label_index))
+            return m_postings[label_index].getIds(ents, false);
+        bool dontclear = false;
+        for(auto index : getSubsumedIndexes(label_index))
+        {
+            m_dls.get(index, ents, dontclear);
+        }
+        return ents.size();
+    }
+
+    //! Computes the entity renumbering that groups the entities by pair index; perm[old id] = new id and perm[0] = 0
+    //! The pair indexes are ordered by the smallest cluster id of their labels if label_clusters is given
+    //! (labels beyond label_clusters go last), then by pair index; unlabeled entities are moved to the end
+    std::size_t getRenumbering(std::vector<std::size_t> &perm, const std::vector<std::size_t> *label_clusters = nullptr) const
+    {
+        std::size_t num_items = m_dls.size_items();
+        perm.assign(num_items+1, 0);
+        if(!num_items)
+            return 0;
+        // order of the pair indexes
+        std::vector<std::pair<std::size_t, std::size_t>> order;
+        for(std::size_t index = 1; index < m_index2labels.size(); ++index)
+        {
+            if(!m_dls.count(index))
+                continue;
+            std::size_t cluster = 0;
+            if(label_clusters)
+            {
+                cluster = std::size_t(-1);
+                for(auto label : m_index2labels[index])
+                {
+                    if(label < label_clusters->size())
+                        cluster = std::min(cluster, (*label_clusters)[label]);
+                }
+            }
+            order.push_back({cluster, index});
+        }
+        std::sort(order.begin(), order.end());
+        // first new id of each pair index; counting sort of the entities
+        std::vector<std::size_t> start(m_index2labels.size(), 0);
+        std::size_t next = 1;
+        for(auto &pr : order)
+        {
+            start[pr.second] = next;
+            next += m_dls.count(pr.second);
+        }
+        for(std::size_t gv = 1; gv <= num_items; ++gv)
+        {
+            std::size_t pair_index = m_dls.get_label(gv);
+            perm[gv] = pair_index ? start[pair_index]++ : next++;
+        }
+        return num_items;
+    }
+
+    //! Renumbers the entities in place with perm[old id] = new id (see getRenumbering)
+    void applyRenumbering(const std::vector<std::size_t> &perm)
+    {
+        m_bitmaps.clear();
+        m_dls.permute(perm);
+        std::vector<std::size_t> ids;
+        for(auto label : m_posting_labels)
+        {
+            m_postings[label].getIds(ids);
+            for(auto &id : ids)
+            {
+                if(id < perm.size())
+                    id = perm[id];
+            }
+            std::sort(ids.begin(), ids.end());
+            m_postings[label] = LabelBitmap(ids);
+        }
+        rebuildPosted();
+        for(auto &query : m_queries)
+        {
+            if(!query.active)
+                continue;
+            for(auto &delta : query.deltas)
+            {
+                if(delta.gv < perm.size())
+                    delta.gv = perm[delta.gv];
+            }
+            seedQuery(query);
+        }
+    }
+
+    //! Computes the renumbering grouping the entities by pair index, applies it and returns it for the host graph
+    std::size_t renumber(std::vector<std::size_t> &perm, const std::vector<std::size_t> *label_clusters = nullptr)
+    {
+        std::size_t num_items = getRenumbering(perm, label_clusters);
+        applyRenumbering(perm);
+        return num_items;
+    }
+
+    //! Stores the runs of at least min_run consecutive entities sharing a pair index as intervals; returns the number of intervals
+    std::size_t compact(std::size_t min_run = 64)
+    {
+        return m_dls.compact(min_run);
+    }
+
+    //! Moves all the interval entities back into the chains
+    void expand()
+    {
+        m_dls.expand();
+    }
+
     //! Removes the label index from an entity gv
     std::size_t delLabel(std::size_t gv, std::size_t label_index)
     {       
         // get the node's pair index.
         std::size_t pair_index = m_dls.get_label(gv);
-         m_dls.del_item(gv);
+        if(isPosting(label_index))
+        {
+            if(!unpost(gv, label_index))
+                std::cout << "node " << gv <<  " does not have label " << label_index << std::endl;
+            return pair_index;
+        }
         if(!pair_index)
         {
             std::cout << "node " << gv <<  " does not have any label " << std::endl;
             return 0;
         }
         std::size_t old_index = pair_index;                    
-        const std::vector<std::size_t> &existing = m_index2labels[pair_index];
-        std::vector<std::size_t> newpair(existing);
-        auto it = std::find(newpair.begin(), newpair.end(), label_index);
-        if(it != newpair.end())
-        {    
-            newpair.erase(it);            
-            pair_index = (newpair.empty()) ? 0 : addLabel(newpair);
-        }  
-        else
+        pair_index = transition(old_index, label_index, true);
+        if(pair_index == old_index)
         {
             std::cout << "node " << gv <<  " does not have label " << label_index << std::endl;
             return 0;
         }
         
-        // deletes existing
-        if(pair_index && old_index != pair_index)
-        {           
-            m_dls.insert(gv,pair_index);
-        }
+        // moves to the new pair index or deletes existing
+        moveEntity(gv,pair_index);
         
         if(old_index && old_index != pair_index)
         {
@@ -254,33 +628,207 @@ protected:
     //! Removes the label_index from all entities
     void delLabel(std::size_t label_index)
     {      
+        if(isPosting(label_index))
+        {
+            std::vector<std::size_t> ents;
+            m_postings[label_index].getIds(ents);
+            for(auto gv : ents)
+                unpost(gv, label_index);
+            return;
+        }
         std::vector<std::size_t> ents;
         if(getEntities(label_index, ents))
         {            
-            for(auto ent : ents)
-            {             
-                delLabel(ent,label_index);              
-            }
+            delLabel(ents, label_index);
+        }
+    }
+
+    //! Adds the label index to all entities gvs; the entities are grouped by pair index and each group is moved in bulk
+    void addLabel(const std::vector<std::size_t> &gvs, std::size_t label_index)
+    {
+        if(isPosting(label_index))
+        {
+            m_postings[label_index].add(gvs);
+            for(auto gv : gvs)
+                SortedSets::insert(m_posted[gv], label_index);
+            return;
+        }
+        moveGroups(gvs, label_index, false);
+        checkTuples();
+    }
+
+    //! Removes the label index from all entities gvs in bulk; entities w/o the label are left as is
+    void delLabel(const std::vector<std::size_t> &gvs, std::size_t label_index)
+    {
+        if(isPosting(label_index))
+        {
+            for(auto gv : gvs)
+                unpost(gv, label_index);
+            return;
         }
+        moveGroups(gvs, label_index, true);
+    }
+
+    //! Returns the pair index of the labels set of pair_index with label_index added (del = false) or removed (del = true)
+    //! creates the labels set if new; returns pair_index itself if nothing changes. The answer is memoized
+    std::size_t transition(std::size_t pair_index, std::size_t label_index, bool del)
+    {
+        std::pair<std::size_t, std::size_t> key(pair_index, 2*label_index + (del ? 1 : 0));
+        auto it = m_transitions.find(key);
+        if(it != m_transitions.end() && it->second.second == generation(it->second.first))
+            return it->second.first;
+        std::size_t new_index = pair_index;
+        std::vector<std::size_t> newpair;
+        if(pair_index && pair_index < m_index2labels.size())
+            newpair = m_index2labels[pair_index];
+        auto pos = std::lower_bound(newpair.begin(), newpair.end(), label_index);
+        bool exists = (pos != newpair.end() && *pos == label_index);
+        if(del && exists)
+        {
+            newpair.erase(pos);
+            new_index = newpair.empty() ? 0 : addLabel(newpair);
+        }
+        else if(!del && !exists)
+        {
+            newpair.insert(pos, label_index);
+            new_index = addLabel(newpair);
+        }
+        m_transitions[key] = std::make_pair(new_index, generation(new_index));
+        return new_index;
     }
     
-    //! Removes the entity from being associated to the labels; TO_DO: revise pair indexes
+    //! Removes the entity from being associated to the labels; its pair index is recycled if no other entity has it
     void removeEntityFromLabels(std::size_t gv)
     {
-        m_dls.del_item(gv);
+        auto it = m_posted.find(gv);
+        if(it != m_posted.end())
+        {
+            for(auto label : it->second)
+                m_postings[label].remove(gv);
+            m_posted.erase(it);
+        }
+        std::size_t old_index = m_dls.get_label(gv);
+        moveEntity(gv,0);
+        if(old_index)
+            recycle(old_index);
+    }
+
+    //! Returns the number of entities associated with a label index
+    std::size_t getLabelCount(std::size_t label_index) const
+    {
+        if(isPosting(label_index))
+            return m_postings[label_index].cardinality();
+        std::lock_guard<std::mutex> lock(m_sync.mutex);
+        syncCooccurrence();
+        if(label_index >= m_cooc.size())
+            return 0;
+        auto it = m_cooc[label_index].find(label_index);
+        return (it != m_cooc[label_index].end()) ? it->second : 0;
+    }
+
+    //! Returns the label co-occurrence graph as an edge list of (label, other label, number of entities having both) triples
+    //! where label < other label; the edge percentage w.r.t. a label is the weight over its getLabelCount
+    std::size_t getCooccurrence(std::vector<std::size_t> &edges) const
+    {
+        std::lock_guard<std::mutex> lock(m_sync.mutex);
+        syncCooccurrence();
+        std::vector<std::map<std::size_t, std::size_t>> merged;
+        const std::vector<std::map<std::size_t, std::size_t>> &cooc = getCooccurrenceRows(merged);
+        edges.clear();
+        for(std::size_t label = 0; label < cooc.size(); ++label)
+        {
+            for(auto it = cooc[label].upper_bound(label); it != cooc[label].end(); ++it)
+            {
+                edges.push_back(label);
+                edges.push_back(it->first);
+                edges.push_back(it->second);
+            }
+        }
+        return edges.size()/3;
+    }
+
+    //! Returns the symmetric label co-occurrence graph in CSR format; neighbors of label i are adjacency[offsets[i]..offsets[i+1])
+    std::size_t getCooccurrence(std::vector<std::size_t> &offsets, std::vector<std::size_t> &adjacency, 
+                                std::vector<std::size_t> &weights) const
+    {
+        std::lock_guard<std::mutex> lock(m_sync.mutex);
+        syncCooccurrence();
+        std::vector<std::map<std::size_t, std::size_t>> merged;
+        const std::vector<std::map<std::size_t, std::size_t>> &cooc = getCooccurrenceRows(merged);
+        offsets.assign(cooc.size()+1, 0);
+        for(std::size_t label = 0; label < cooc.size(); ++label)
+        {
+            for(auto it = cooc[label].upper_bound(label); it != cooc[label].end(); ++it)
+            {
+                offsets[label+1]++;
+                offsets[it->first+1]++;
+            }
+        }
+        for(std::size_t label = 0; label < cooc.size(); ++label)
+            offsets[label+1] += offsets[label];
+        adjacency.resize(offsets.back());
+        weights.resize(offsets.back());
+        std::vector<std::size_t> pos(offsets.begin(), offsets.end()-1);
+        for(std::size_t label = 0; label < cooc.size(); ++label)
+        {
+            for(auto it = cooc[label].upper_bound(label); it != cooc[label].end(); ++it)
+            {
+                adjacency[pos[label]] = it->first;
+                weights[pos[label]++] = it->second;
+                adjacency[pos[it->first]] = label;
+                weights[pos[it->first]++] = it->second;
+            }
+        }
+        // rows in increasing label order
+        for(std::size_t label = 0; label < cooc.size(); ++label)
+        {
+            std::vector<std::pair<std::size_t, std::size_t>> row;
+            for(std::size_t i = offsets[label]; i < offsets[label+1]; ++i)
+                row.push_back({adjacency[i], weights[i]});
+            std::sort(row.begin(), row.end());
+            for(std::size_t i = 0; i < row.size(); ++i)
+            {
+                adjacency[offsets[label]+i] = row[i].first;
+                weights[offsets[label]+i]   = row[i].second;
+            }
+        }
+        return adjacency.size();
+    }
+
+    //! Returns the pair index (labels set) of the entity, 0 if it has no label
+    std::size_t getPairIndex(std::size_t gv) const
+    {
+        return m_dls.get_label(gv);
+    }
+
+    //! Returns the entities associated with a pair index
+    std::size_t getIndexEntities(std::size_t pair_index, std::vector<std::size_t> &ents, bool clear = true) const
+    {
+        return m_dls.get(pair_index, ents, clear);
+    }
+
+    //! Returns the labels set of a pair index
+    const std::vector<std::size_t> &getIndexLabels(std::size_t pair_index) const
+    {
+        static const std::vector<std::size_t> none;
+        return (pair_index < m_index2labels.size()) ? m_index2labels[pair_index] : none;
     }
 
     bool hasLabel(std::size_t gv) const
     {
+        if(m_posted.count(gv))
+            return true;
         return (gv > m_dls.size_items()) ? false : m_dls.get_label(gv);
     }
 
     bool hasLabel(std::size_t gv, std::size_t label_index) const
     {
+        if(isPosting(label_index))
+            return m_postings[label_index].contains(gv);
         std::size_t pair_index = m_dls.get_label(gv);
         if(!pair_index)
             return false;
-        return std::binary_search(m_index2labels[pair_index].begin(), m_index2labels[pair_index].end(), label_index);
+        return SortedSets::contains(m_index2labels[pair_index], label_index);
     }
 
     //! Prints all
@@ -324,7 +872,7 @@ protected:
             out << std::endl;
         }
         m_dls.print(out);       
-        for(std::size_t i = 1; i < m_label2indexes.size(); ++i)
+        for(std::size_t i = 1; i < std::max(m_label2indexes.size(), m_posting.size()); ++i)
         {
             print(i,out);
         }
@@ -359,6 +907,8 @@ protected:
     {
         if(clear)
             ents.clear();
+        if(isPosting(label_index))
+            return m_postings[label_index].getIds(ents, false);
         bool dontclear = false;
         if(label_index < m_label2indexes.size())
         {
@@ -372,6 +922,119 @@ protected:
         return ents.size();
     }
     
+    //! Returns the first k entities associated with the label in the order of getEntities; only those are visited
+    std::size_t getFirstEntities(std::size_t label_index, std::size_t k, std::vector<std::size_t> &ents) const
+    {
+        ents.clear();
+        if(isPosting(label_index))
+            return m_postings[label_index].getIds(ents, true, k);
+        if(label_index >= m_label2indexes.size())
+            return 0;
+        for(auto index : m_label2indexes[label_index])
+        {
+            if(ents.size() >= k)
+                break;
+            m_dls.head(index, k - ents.size(), ents);
+        }
+        return ents.size();
+    }
+
+    //! Returns k entities associated with the label drawn uniformly without replacement (all of them if there are at
+    //! most k). The positions are drawn over the full entity count of the label (Floyd's selection) and located in the
+    //! pair indexes by their entity counts; interval entities are reached directly. The exact mode walks the chain of a
+    //! pair index from its head up to its last drawn position; otherwise each position is reached from the nearest skip
+    //! point before it (about SingleDLS::SKIP_DISTANCE steps). Both modes draw the same entities for the same seed.
+    //! A posting label's positions are selected in its bitmap
+    std::size_t sampleEntities(std::size_t label_index, std::size_t k, std::vector<std::size_t> &ents, std::size_t seed = 0,
+                               bool exact = true) const
+    {
+        ents.clear();
+        std::mt19937_64 rng(seed);
+        std::vector<std::size_t> positions;
+        if(isPosting(label_index))
+        {
+            const LabelBitmap &posting = m_postings[label_index];
+            std::size_t total = posting.cardinality();
+            if(total <= k)
+                return posting.getIds(ents);
+            drawPositions(total, k, rng, positions);
+            return posting.select(positions, ents);
+        }
+        if(label_index >= m_label2indexes.size() || !k)
+            return 0;
+        const std::vector<std::size_t> &indexes = m_label2indexes[label_index];
+        std::size_t total = 0;
+        for(auto index : indexes)
+            total += m_dls.count(index);
+        if(total <= k)
+            return getEntities(label_index, ents);
+        drawPositions(total, k, rng, positions);
+        std::vector<std::size_t> local;
+        std::size_t p = 0, offset = 0;
+        for(auto index : indexes)
+        {
+            std::size_t n = m_dls.count(index);
+            local.clear();
+            for(; p < positions.size() && positions[p] < offset + n; ++p)
+                local.push_back(positions[p] - offset);
+            offset += n;
+            if(!local.empty())
+                m_dls.select(index, local, ents, !exact);
+        }
+        return ents.size();
+    }
+
+    //! Returns all entities associated with a label index as a bitmap; caches the bitmap of the label if cache is set
+    std::size_t getEntities(std::size_t label_index, LabelBitmap &ents, bool cache = false) const
+    {
+        if(isPosting(label_index))
+        {
+            ents = m_postings[label_index];
+            return ents.cardinality();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_sync.mutex);
+            auto it = m_bitmaps.find(label_index);
+            if(it != m_bitmaps.end())
+            {
+                ents = it->second;
+                return ents.cardinality();
+            }
+        }
+        ents.clear();
+        if(label_index < m_label2indexes.size())
+        {
+            for(auto index : m_label2indexes[label_index])
+                getIndexEntities(index, ents);
+        }
+        if(cache)
+        {
+            std::lock_guard<std::mutex> lock(m_sync.mutex);
+            m_bitmaps[label_index] = ents;
+        }
+        return ents.cardinality();
+    }
+
+    //! Returns all entities associated with a label index or any of its descendants as a bitmap (posting labels included)
+    std::size_t getSubsumedEntities(std::size_t label_index, LabelBitmap &ents) const
+    {
+        if(isPosting(label_index))
+        {
+            ents = m_postings[label_index];
+            return ents.cardinality();
+        }
+        ents.clear();
+        for(auto index : getSubsumedIndexes(label_index))
+            getIndexEntities(index, ents);
+        return ents.cardinality();
+    }
+
+    //! Drops the cached bitmaps
+    void clearBitmapCache()
+    {
+        m_bitmaps.clear();
+    }
+
     //! Returns labels associated with an entity
     std::size_t getLabels(std::size_t gv, std::vector<std::size_t> &labels) const
     {
@@ -384,62 +1047,612 @@ protected:
         {
             labels = m_index2labels[pair_index];
         }
+        auto it = m_posted.find(gv);
+        if(it == m_posted.end())
+            return labels.size();
+        std::size_t tupled = labels.size();
+        labels.insert(labels.end(), it->second.begin(), it->second.end());
+        std::inplace_merge(labels.begin(), labels.begin()+tupled, labels.end());
         return labels.size();        
     }
     
-    //! Serialized write to a binary output stream
-    void write(std::ostream &out) const
+    //! Returns the labels of n entities grouped by tuple: the distinct labels sets touched are listed once each and
+    //! every entity gets the id of its tuple; the per entity CSR expansion is filled only if csr is set. The pair
+    //! indexes are gathered in one prefetched pass (see SingleDLS::get_labels). Returns the number of tuples
+    std::size_t projectLabels(const std::size_t *gvs, std::size_t n, LabelProjection &projection, bool csr = false) const
     {
-        std::size_t vsize = m_index2labels.size();
-        out.write((char*)&vsize, sizeof(std::size_t));
-        if(vsize==0)
-            return;
-        for(std::size_t index = 0; index < m_index2labels.size(); ++index)
+        projection.clear();
+        projection.tuple_ids.resize(n);
+        m_dls.get_labels(gvs, n, projection.tuple_ids.data());
+        if(m_posting_labels.empty())
         {
-            vsize = m_index2labels[index].size();
-            out.write((char*)&vsize,sizeof(std::size_t));
-            if(vsize ==  0)
-                continue;            
-            out.write((char*)&m_index2labels[index][0], sizeof(std::size_t)*vsize);
+            // sized to the batch, not to the number of pair indexes
+            std::unordered_map<std::size_t, std::size_t> local; //- pair index --> tuple id
+            local.reserve(std::min(n, m_index2labels.size()));
+            for(auto &id : projection.tuple_ids)
+            {
+                if(!id || id >= m_index2labels.size())
+                {
+                    id = 0;
+                    continue;
+                }
+                std::size_t &tuple = local[id];
+                if(!tuple)
+                {
+                    const std::vector<std::size_t> &labels = m_index2labels[id];
+                    projection.pair_indexes.push_back(id);
+                    projection.tuple_labels.insert(projection.tuple_labels.end(), labels.begin(), labels.end());
+                    projection.tuple_offsets.push_back(projection.tuple_labels.size());
+                    tuple = projection.pair_indexes.size();
+                }
+                id = tuple;
+            }
+        }
+        else
+        {
+            // the posting labels make the labels set depend on the entity, not only on its pair index: the tuples are
+            // keyed by pair index and posting labels signature, the posting labels of each entity are looked up once
+            std::map<std::vector<std::size_t>, std::size_t> signatures;          //- posting labels --> signature (from 1)
+            std::map<std::pair<std::size_t, std::size_t>, std::size_t> local; //- (pair index, signature) --> tuple id
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                std::size_t &id = projection.tuple_ids[i];
+                std::size_t index = (id < m_index2labels.size()) ? id : 0, signature = 0;
+                auto posted = m_posted.find(gvs[i]);
+                if(posted != m_posted.end())
+                {
+                    auto it = signatures.find(posted->second);
+                    if(it == signatures.end())
+                        it = signatures.insert(std::make_pair(posted->second, signatures.size()+1)).first;
+                    signature = it->second;
+                }
+                if(!index && !signature)
+                {
+                    id = 0;
+                    continue;
+                }
+                std::size_t &tuple = local[std::make_pair(index, signature)];
+                if(!tuple)
+                {
+                    static const std::vector<std::size_t> none;
+                    const std::vector<std::size_t> &tupled = index ? m_index2labels[index] : none;
+                    const std::vector<std::size_t> &labels = signature ? posted->second : none;
+                    projection.pair_indexes.push_back(index);
+                    std::merge(tupled.begin(), tupled.end(), labels.begin(), labels.end(), std::back_inserter(projection.tuple_labels));
+                    projection.tuple_offsets.push_back(projection.tuple_labels.size());
+                    tuple = projection.pair_indexes.size();
+                }
+                id = tuple;
+            }
+        }
+        if(csr)
+        {
+            projection.offsets.resize(n+1);
+            projection.offsets[0] = 0;
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                std::size_t t = projection.tuple_ids[i];
+                projection.offsets[i+1] = projection.offsets[i] + (t ? projection.tuple_offsets[t] - projection.tuple_offsets[t-1] : 0);
+            }
+            projection.labels.resize(projection.offsets[n]);
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                std::size_t t = projection.tuple_ids[i];
+                if(t)
+                    std::copy(projection.tuple_labels.begin() + projection.tuple_offsets[t-1], projection.tuple_labels.begin() + projection.tuple_offsets[t],
+                              projection.labels.begin() + projection.offsets[i]);
+            }
+        }
+        return projection.size_tuples();
+    }
+
+    std::size_t projectLabels(const std::vector<std::size_t> &gvs, LabelProjection &projection, bool csr = false) const
+    {
+        return projectLabels(gvs.data(), gvs.size(), projection, csr);
+    }
+
+    //! Registers a standing label query; returns its id. The current result is available right away (see getQueryResult)
+    //! and the later changes are buffered as deltas (see drainQuery) or pushed to the subscriber by flushQueries.
+    //! An empty expression is rejected with the id std::size_t(-1)
+    std::size_t registerQuery(const LabelExpression &expr, QuerySubscriber subscriber = QuerySubscriber())
+    {
+        if(expr.empty())
+            return std::size_t(-1);
+        std::vector<std::size_t> labels;
+        expr.getLabels(labels);
+        for(auto label : labels)
+            setPostingLabel(label, false);
+        StandingQuery query;
+        query.expr = expr;
+        query.subscriber = subscriber;
+        query.active = true;
+        query.count = 0;
+        m_queries.push_back(query);
+        evaluateQuery(m_queries.back());
+        return m_queries.size()-1;
+    }
+
+    //! Stops maintaining a standing label query
+    void unregisterQuery(std::size_t query_id)
+    {
+        if(query_id >= m_queries.size())
+            return;
+        StandingQuery &query = m_queries[query_id];
+        query.active = false;
+        query.subscriber = QuerySubscriber();
+        std::vector<char>().swap(query.matches);
+        query.result.clear();
+        std::vector<LabelQueryDelta>().swap(query.deltas);
+        query.count = 0;
+    }
+
+    //! Returns the number of entities matching a standing query
+    std::size_t getQueryCount(std::size_t query_id) const
+    {
+        return (query_id < m_queries.size()) ? m_queries[query_id].count : 0;
+    }
+
+    //! Returns the entities matching a standing query
+    const LabelBitmap &getQueryResult(std::size_t query_id) const
+    {
+        static const LabelBitmap none;
+        return (query_id < m_queries.size()) ? m_queries[query_id].result : none;
+    }
+
+    //! Moves the buffered deltas of a standing query into deltas; returns their number
+    std::size_t drainQuery(std::size_t query_id, std::vector<LabelQueryDelta> &deltas)
+    {
+        deltas.clear();
+        if(query_id < m_queries.size())
+            deltas.swap(m_queries[query_id].deltas);
+        return deltas.size();
+    }
+
+    //! Pushes the buffered deltas of each standing query to its subscriber
+    void flushQueries()
+    {
+        std::vector<LabelQueryDelta> deltas;
+        for(std::size_t query_id = 0; query_id < m_queries.size(); ++query_id)
+        {
+            StandingQuery &query = m_queries[query_id];
+            if(!query.subscriber || query.deltas.empty())
+                continue;
+            deltas.clear();
+            deltas.swap(query.deltas);
+            query.subscriber(query_id, deltas);
+        }
+    }
+
+    //! Registers a listener called with the entities after they moved from a pair index to another (0: no label);
+    //! companion indexes (e.g. LabelPathIndex.h) follow the container through it. clear, read and renumber do not
+    //! call the listeners. Returns the listener id
+    std::size_t addMoveListener(MoveListener listener)
+    {
+        m_listeners.push_back(listener);
+        return m_listeners.size()-1;
+    }
+
+    //! Unregisters a move listener
+    void removeMoveListener(std::size_t listener_id)
+    {
+        if(listener_id < m_listeners.size())
+            m_listeners[listener_id] = MoveListener();
+    }
+
+    //! Sets the policy of the adaptive posting labels; an adaptive policy is checked right away
+    void setTuplePolicy(const TuplePolicy &policy)
+    {
+        m_policy = policy;
+        m_next_check = 0;
+        checkTuples();
+    }
+
+    const TuplePolicy &getTuplePolicy() const
+    {
+        return m_policy;
+    }
+
+    //! Returns the pair index (tuple) statistics used by the policy
+    TupleStats getTupleStats() const
+    {
+        TupleStats stats;
+        stats.entities = m_dls.size_items();
+        stats.tuples = m_labels2index.size();
+        stats.ratio = stats.entities ? double(stats.tuples)/stats.entities : 0;
+        std::size_t num_labels = 0;
+        for(auto &pr : m_labels2index)
+            num_labels += pr.first.size();
+        stats.labels_per_tuple = stats.tuples ? double(num_labels)/stats.tuples : 0;
+        stats.posting_labels = m_posting_labels.size();
+        stats.posting_entries = 0;
+        for(auto label : m_posting_labels)
+            stats.posting_entries += m_postings[label].cardinality();
+        return stats;
+    }
+
+    //! Turns the labels most spread over the pair indexes (pair indexes per entity of the label) into posting labels
+    //! while the tuple ratio exceeds the policy, regardless of whether the policy is adaptive. Labels of the is-a
+    //! hierarchy and of standing queries are kept in the tuples. Returns the number of labels turned into posting labels
+    std::size_t adaptTuples()
+    {
+        std::size_t converted = 0;
+        std::size_t entities = m_dls.size_items();
+        while(entities >= m_policy.min_entities && m_labels2index.size() > m_policy.max_ratio*entities)
+        {
+            // most pair indexes per entity; the smaller label on ties
+            std::size_t best = 0, best_indexes = 0, best_count = 1;
+            for(std::size_t label = 1; label < m_label2indexes.size(); ++label)
+            {
+                const std::vector<std::size_t> &indexes = m_label2indexes[label];
+                if(indexes.size() < m_policy.min_indexes || !canPost(label))
+                    continue;
+                std::size_t count = 0;
+                for(auto index : indexes)
+                    count += m_dls.count(index);
+                double lhs = double(indexes.size())*best_count, rhs = double(best_indexes)*count;
+                if(lhs > rhs || (lhs == rhs && count < best_count))
+                {
+                    best = label;
+                    best_indexes = indexes.size();
+                    best_count = count;
+                }
+            }
+            if(!best)
+                break;
+            setPostingLabel(best, true);
+            ++converted;
+        }
+        m_next_check = m_labels2index.size() + m_labels2index.size()/8 + 1;
+        return converted;
+    }
+
+    //! Moves the label out of the pair indexes into a posting (entity bitmap) of its own (posting = true) or back into the
+    //! pair indexes (posting = false). Queries are answered the same either way. Returns false if the label cannot be
+    //! a posting label (is-a hierarchy or standing query label)
+    bool setPostingLabel(std::size_t label_index, bool posting)
+    {
+        if(!label_index || posting == isPosting(label_index))
+            return true;
+        if(!posting)
+        {
+            std::vector<std::size_t> ents;
+            m_postings[label_index].getIds(ents);
+            for(auto gv : ents)
+                unpost(gv, label_index);
+            m_posting[label_index] = 0;
+            SortedSets::erase(m_posting_labels, label_index);
+            moveGroups(ents, label_index, false);
+            return true;
+        }
+        if(!canPost(label_index))
+            return false;
+        if(label_index >= m_posting.size())
+        {
+            m_posting.resize(label_index+1, 0);
+            m_postings.resize(label_index+1);
+        }
+        LabelBitmap &ids = m_postings[label_index];
+        std::vector<std::size_t> indexes, ents;
+        if(label_index < m_label2indexes.size())
+            indexes = m_label2indexes[label_index];
+        for(auto index : indexes)
+        {
+            getIndexEntities(index, ents);
+            ids.add(ents);
+            for(auto gv : ents)
+                SortedSets::insert(m_posted[gv], label_index);
+            moveEntities(ents, index, transition(index, label_index, true));
+            recycle(index);
+        }
+        m_posting[label_index] = 1;
+        SortedSets::insert(m_posting_labels, label_index);
+        m_bitmaps.erase(label_index);
+        return true;
+    }
+
+    //! Returns true if the label is kept as a posting label
+    bool isPosting(std::size_t label_index) const
+    {
+        return label_index < m_posting.size() && m_posting[label_index];
+    }
+
+    //! Serialized write to a binary output stream; a format marker and version precede the labels sets
+    void write(std::ostream &out) const
+    {
+        if(!writeLabelsSets(out, m_index2labels))
+        {
+            writePostings(out);
+            return;
         }
         m_dls.write(out);
         out.write((char*)&m_maxid, sizeof(std::size_t));
         SingleDLS::write(out,m_recycle);
+        writePostings(out);
     }
       
-    //! Serialized read from a binary input stream
+    //! Serialized read from a binary input stream. Streams written before the format marker was added (no posting
+    //! labels) are read as such; a newer version than FORMAT_VERSION sets the failbit
     void read(std::istream &in)
     {
         clear();
         m_index2labels.clear();
-        std::size_t vsize = 0;
-        in.read((char*)&vsize, sizeof(std::size_t));
-        if(vsize == 0)
-            return;        
-        m_index2labels.resize(vsize);
-        for(std::size_t i = 0; i < m_index2labels.size(); ++i)
-        {             
-            in.read((char*)&vsize, sizeof(std::size_t));
-            if(vsize == 0)
-                continue;
-            m_index2labels[i].resize(vsize);         
-            in.read((char*)&m_index2labels[i][0], vsize*sizeof(std::size_t));
-        }        
+        std::size_t version = 0;
+        if(!readLabelsSets(in, m_index2labels, version))
+        {
+            if(version >= 1)
+                readPostings(in);
+            return;
+        }
         // populate others
-        for(std::size_t index = 1; index < m_index2labels.size(); ++index)
-        {            
-            m_labels2index.insert({m_index2labels[index],index});            
-            for(auto label : m_index2labels[index])
-            {                                
-                if(label >= m_label2indexes.size())
-                    m_label2indexes.resize(label+1);
-                m_label2indexes[label].push_back(index);
-            }            
-        }  
+        rebuildIndexes();
         // read dls
         m_dls.read(in);
         in.read((char*)&m_maxid, sizeof(std::size_t));
         SingleDLS::read(in,m_recycle);
+        if(version >= 1)
+            readPostings(in);
+        rebuildDerived();
+    }
+
+    //! Writes the container to a chunked file (see LabelFile.h): the pair indexes of the entities are cut into blocks
+    //! that are encoded, checksummed and written in parallel. Returns false on an I/O error
+    bool writeFile(const std::string &filename, const LabelFile::Options &options = LabelFile::Options()) const
+    {
+        std::ostringstream dictionary;
+        writeLabelsSets(dictionary, m_index2labels);
+        dictionary.write((char*)&m_maxid, sizeof(std::size_t));
+        SingleDLS::write(dictionary, m_recycle);
+        writePostings(dictionary);
+        const SingleDLS &dls = m_dls;
+        return LabelFile::write(filename, dictionary.str(), m_dls.size_items(), options,
+            [&dls](std::size_t first, std::size_t count, std::size_t *pair_indexes)
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    pair_indexes[i] = dls.get_label(first+i);
+            });
+    }
+
+    //! Reads a chunked file written by writeFile; the blocks are read and decoded, the label maps rebuilt and the
+    //! entity chains linked on num_threads threads (0 --> hardware concurrency). Intervals are not restored, see compact.
+    //! Returns false if the file is missing or corrupt, leaving the container empty
+    bool readFile(const std::string &filename, std::size_t num_threads = 0)
+    {
+        if(!num_threads)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        clear();
+        m_index2labels.clear();
+        LabelFile file;
+        std::istringstream dictionary(file.open(filename) ? file.getDictionary() : std::string());
+        std::size_t version = 0;
+        if(!readLabelsSets(dictionary, m_index2labels, version) || !dictionary.read((char*)&m_maxid, sizeof(std::size_t)))
+        {
+            clear();
+            m_index2labels.clear();
+            return false;
+        }
+        SingleDLS::read(dictionary, m_recycle);
+        if(version >= 1)
+            readPostings(dictionary);
+        std::vector<std::size_t> pair_indexes(file.size_items()+1, 0);
+        bool ok = file.readBlocks(1, file.size_items(), num_threads,
+            [&pair_indexes](std::size_t first, std::size_t count, const std::size_t *values)
+            {
+                std::copy(values, values+count, pair_indexes.begin()+first);
+            });
+        if(!ok)
+        {
+            clear();
+            m_index2labels.clear();
+            return false;
+        }
+        rebuildIndexes(num_threads);
+        m_dls.assign(pair_indexes, m_index2labels.empty() ? 0 : m_index2labels.size()-1, num_threads);
+        rebuildDerived();
+        return true;
+    }
+
+    //! Reads the pair indexes of the entities first..last from a chunked file without loading it; only the blocks
+    //! overlapping the range are read. pair_indexes[i] is the pair index of the entity first+i and index2labels
+    //! gives the labels set of each pair index. The posting labels of the range are merged: an entity having any gets
+    //! a pair index past the file's ones whose labels set includes them. Returns false if the file is missing or corrupt
+    static bool readRange(const std::string &filename, std::size_t first, std::size_t last, std::vector<std::size_t> &pair_indexes,
+                          std::vector<std::vector<std::size_t>> &index2labels, std::size_t num_threads = 1)
+    {
+        pair_indexes.clear();
+        index2labels.clear();
+        LabelFile file;
+        if(!file.open(filename))
+            return false;
+        std::istringstream dictionary(file.getDictionary());
+        std::size_t version = 0;
+        if(!readLabelsSets(dictionary, index2labels, version))
+            return false;
+        if(first < 1)
+            first = 1;
+        last = std::min(last, file.size_items());
+        if(first > last)
+            return true;
+        pair_indexes.assign(last - first + 1, 0);
+        if(!file.readBlocks(first, last, num_threads,
+            [&pair_indexes, first, last](std::size_t begin, std::size_t count, const std::size_t *values)
+            {
+                std::size_t lo = std::max(begin, first), hi = std::min(begin + count - 1, last);
+                std::copy(values + (lo - begin), values + (hi - begin) + 1, pair_indexes.begin() + (lo - first));
+            }))
+            return false;
+        if(version < 1)
+            return true;
+        // (entity offset, posting label) of the range; the labels come in increasing order
+        std::size_t maxid = 0, num_postings = 0, label = 0;
+        std::vector<std::size_t> recycle, ids;
+        dictionary.read((char*)&maxid, sizeof(std::size_t));
+        SingleDLS::read(dictionary, recycle);
+        dictionary.read((char*)&num_postings, sizeof(std::size_t));
+        LabelBitmap range, posting;
+        range.addRange(first, last);
+        std::vector<std::pair<std::size_t, std::size_t>> posted;
+        for(std::size_t i = 0; i < num_postings && dictionary.read((char*)&label, sizeof(std::size_t)); ++i)
+        {
+            posting.read(dictionary);
+            posting.andWith(range);
+            posting.getIds(ids);
+            for(auto gv : ids)
+                posted.push_back(std::make_pair(gv - first, label));
+        }
+        if(!dictionary)
+            return false;
+        std::stable_sort(posted.begin(), posted.end(), [](const std::pair<std::size_t, std::size_t> &a, const std::pair<std::size_t, std::size_t> &b)
+        {
+            return a.first < b.first;
+        });
+        // one merged labels set per (pair index, posting labels)
+        std::map<std::pair<std::size_t, std::vector<std::size_t>>, std::size_t> merged;
+        std::vector<std::size_t> labels;
+        if(index2labels.empty())
+            index2labels.resize(1);
+        for(std::size_t i = 0; i < posted.size(); )
+        {
+            std::size_t offset = posted[i].first;
+            labels.clear();
+            for(; i < posted.size() && posted[i].first == offset; ++i)
+                labels.push_back(posted[i].second);
+            std::size_t &index = pair_indexes[offset];
+            auto it = merged.insert(std::make_pair(std::make_pair(index, labels), index2labels.size())).first;
+            if(it->second == index2labels.size())
+            {
+                std::vector<std::size_t> all;
+                const std::vector<std::size_t> &tupled = index < index2labels.size() ? index2labels[index] : labels;
+                std::set_union(tupled.begin(), tupled.end(), labels.begin(), labels.end(), std::back_inserter(all));
+                index2labels.push_back(all);
+            }
+            index = it->second;
+        }
+        return true;
+    }
+
+    //! Computes the delta turning the labels of the entities first..last of a into those of b. Only the changed entities
+    //! and the labels sets they get are recorded, independent of how either container numbers its pair indexes.
+    //! Returns the number of changed entities
+    static std::size_t diff(const GraphLabelContainer &a, const GraphLabelContainer &b, LabelDelta &delta,
+                            std::size_t first = 1, std::size_t last = std::size_t(-1))
+    {
+        const std::size_t unknown = std::size_t(-1), missing = std::size_t(-2);
+        delta.clear();
+        if(!a.m_posting_labels.empty() || !b.m_posting_labels.empty())
+            return diffLabels(a, b, delta, first, last);
+        last = std::min(last, std::max(a.size(), b.size()));
+        std::vector<std::size_t> a2b, b2delta; //- pair index mappings looked up once
+        std::size_t changed = 0;
+        for(std::size_t gv = std::max<std::size_t>(first, 1); gv <= last; ++gv)
+        {
+            std::size_t index_a = a.m_dls.get_label(gv), index_b = b.m_dls.get_label(gv);
+            if(index_a >= a2b.size())
+                a2b.resize(index_a+1, unknown);
+            if(a2b[index_a] == unknown)
+            {
+                auto it = index_a ? b.m_labels2index.find(a.m_index2labels[index_a]) : b.m_labels2index.end();
+                a2b[index_a] = !index_a ? 0 : (it == b.m_labels2index.end() ? missing : it->second);
+            }
+            if(a2b[index_a] == index_b)
+                continue;
+            if(index_b >= b2delta.size())
+                b2delta.resize(index_b+1, unknown);
+            if(b2delta[index_b] == unknown)
+            {
+                b2delta[index_b] = 0;
+                if(index_b)
+                {
+                    delta.labels_sets.push_back(b.m_index2labels[index_b]);
+                    b2delta[index_b] = delta.labels_sets.size();
+                }
+            }
+            appendRun(delta, gv, b2delta[index_b]);
+            ++changed;
+        }
+        return changed;
+    }
+
+    //! Patches the container in place with a delta computed by diff; the delta tuple ids are mapped to the local pair
+    //! indexes (created if needed) and the entities are moved in bulk per (old, new) pair index. The posting labels of
+    //! the delta labels sets are split off first and added per posting label in bulk. Returns the number of changed
+    //! entities
+    std::size_t apply(const LabelDelta &delta)
+    {
+        std::vector<std::size_t> local(delta.labels_sets.size()+1, 0);
+        std::vector<std::vector<std::size_t>> posted(delta.labels_sets.size()+1); //- posting labels of each delta tuple
+        std::vector<std::size_t> tupled;
+        for(std::size_t tuple = 0; tuple < delta.labels_sets.size(); ++tuple)
+        {
+            tupled.clear();
+            for(auto label : delta.labels_sets[tuple])
+                (isPosting(label) ? posted[tuple+1] : tupled).push_back(label);
+            if(!tupled.empty())
+                local[tuple+1] = addLabel(tupled);
+        }
+        std::vector<std::array<std::size_t, 3>> moves; //- (old index, new index, entity)
+        std::map<std::size_t, std::vector<std::size_t>> additions; //- posting label --> entities getting it
+        std::size_t changed = 0;
+        for(std::size_t i = 0; i+2 < delta.runs.size(); i = i+3)
+        {
+            std::size_t tuple = delta.runs[i+2];
+            if(tuple >= local.size())
+                continue;
+            std::size_t pair_index = local[tuple];
+            const std::vector<std::size_t> &labels = posted[tuple];
+            for(std::size_t gv = delta.runs[i]; gv && gv <= delta.runs[i+1]; ++gv)
+            {
+                std::size_t old_index = m_dls.get_label(gv);
+                bool moved = old_index != pair_index;
+                if(moved)
+                    moves.push_back({{old_index, pair_index, gv}});
+                auto it = m_posted.find(gv);
+                static const std::vector<std::size_t> none;
+                const std::vector<std::size_t> &current = (it != m_posted.end()) ? it->second : none;
+                if(current != labels)
+                {
+                    for(auto label : labels)
+                    {
+                        if(!std::binary_search(current.begin(), current.end(), label))
+                            additions[label].push_back(gv);
+                    }
+                    // current may go away with its last posting label
+                    std::vector<std::size_t> removals;
+                    std::set_difference(current.begin(), current.end(), labels.begin(), labels.end(), std::back_inserter(removals));
+                    for(auto label : removals)
+                        unpost(gv, label);
+                    moved = true;
+                }
+                changed += moved;
+            }
+        }
+        for(auto &it : additions)
+        {
+            m_postings[it.first].add(it.second);
+            for(auto gv : it.second)
+                SortedSets::insert(m_posted[gv], it.first);
+        }
+        std::sort(moves.begin(), moves.end());
+        // the emptied pair indexes are recycled after all the moves as they may be targets too
+        std::vector<std::size_t> items, emptied(local.begin()+1, local.end());
+        for(std::size_t first = 0; first < moves.size(); )
+        {
+            std::size_t last = first;
+            items.clear();
+            while(last < moves.size() && moves[last][0] == moves[first][0] && moves[last][1] == moves[first][1])
+                items.push_back(moves[last++][2]);
+            moveEntities(items, moves[first][0], moves[first][1]);
+            if(moves[first][0])
+                emptied.push_back(moves[first][0]);
+            first = last;
+        }
+        std::sort(emptied.begin(), emptied.end());
+        emptied.erase(std::unique(emptied.begin(), emptied.end()), emptied.end());
+        for(auto index : emptied)
+        {
+            if(index)
+                recycle(index);
+        }
+        return changed;
     }
     
     //! Returns the memory occupied (in bytes)
@@ -451,8 +1664,23 @@ protected:
         total *= 1.5;
         // label2indexes
         total += SingleDLS::memory(m_label2indexes);
+        total += SingleDLS::memory(m_parents) + SingleDLS::memory(m_subsumers) + SingleDLS::memory(m_label2closure);
+        std::lock_guard<std::mutex> lock(m_sync.mutex);
+        total += m_cooc.capacity()*sizeof(std::map<std::size_t, std::size_t>);
+        for(const auto &row : m_cooc)
+            total += row.size()*4*sizeof(std::size_t);
+        total += SingleDLS::memory(m_cooc_counts) + SingleDLS::memory(m_cooc_dirty) + m_cooc_flags.capacity();
+        for(const auto &pr : m_bitmaps)
+            total += pr.second.memory();
+        total += m_transitions.size()*8*sizeof(std::size_t) + SingleDLS::memory(m_generations);
         total += m_dls.memory();  
         total += SingleDLS::memory(m_recycle);        
+        total += m_posting.capacity() + SingleDLS::memory(m_posting_labels) + m_postings.capacity()*sizeof(LabelBitmap);
+        for(auto label : m_posting_labels)
+            total += m_postings[label].memory();
+        total += m_posted.bucket_count()*sizeof(void*) + m_posted.size()*(sizeof(std::pair<std::size_t, std::vector<std::size_t>>) + sizeof(void*));
+        for(const auto &pr : m_posted)
+            total += pr.second.capacity()*sizeof(std::size_t);
         return total + sizeof(std::size_t);                        
     }
 
@@ -465,6 +1693,8 @@ protected:
     std::size_t getEntities(const std::vector<std::size_t> &labels, std::vector<std::size_t> &ents) const
     {
         ents.clear();
+        if(!m_posting_labels.empty())
+            return getExactEntities(labels, ents);
         // labels should be sorted
         auto it = m_labels2index.find(labels);
         if(it != m_labels2index.end())
@@ -477,10 +1707,654 @@ protected:
 
     bool isAssociated(const std::vector<std::size_t> &labels) const
     {
+        std::vector<std::size_t> ents;
+        if(!m_posting_labels.empty())
+            return getExactEntities(labels, ents) > 0;
         auto it = m_labels2index.find(labels);
         return (it != m_labels2index.end()) ? !m_dls.is_deleted_label(it->second) : false;
     }
 
+protected:
+
+    //! Returns true if the label may become a posting label: not in the is-a hierarchy nor in a standing query
+    bool canPost(std::size_t label_index) const
+    {
+        if((label_index < m_parents.size() && !m_parents[label_index].empty()) ||
+           (label_index < m_label2closure.size() && !m_label2closure[label_index].empty()))
+            return false;
+        std::vector<std::size_t> labels;
+        for(auto &query : m_queries)
+        {
+            if(!query.active)
+                continue;
+            query.expr.getLabels(labels);
+            if(std::binary_search(labels.begin(), labels.end(), label_index))
+                return false;
+        }
+        return true;
+    }
+
+    //! Applies the adaptive policy once the pair indexes have grown enough since the last check
+    void checkTuples()
+    {
+        if(m_policy.adaptive && m_labels2index.size() >= m_next_check)
+            adaptTuples();
+    }
+
+    //! Adds gv to the postings of the posting labels among the sorted labels (and, if exact, removes it from its other
+    //! postings); the remaining labels are copied to tupled. Returns false if there are no posting labels
+    bool splitPostings(std::size_t gv, const std::vector<std::size_t> &labels, std::vector<std::size_t> &tupled, bool exact)
+    {
+        if(m_posting_labels.empty())
+            return false;
+        tupled.clear();
+        std::vector<std::size_t> posted;
+        for(auto label : labels)
+            (isPosting(label) ? posted : tupled).push_back(label);
+        auto it = m_posted.find(gv);
+        if(exact && it != m_posted.end())
+        {
+            for(auto label : it->second)
+            {
+                if(!std::binary_search(posted.begin(), posted.end(), label))
+                    m_postings[label].remove(gv);
+            }
+        }
+        for(auto label : posted)
+            m_postings[label].add(gv);
+        if(it == m_posted.end())
+        {
+            if(!posted.empty())
+                m_posted[gv].swap(posted);
+        }
+        else if(exact && posted.empty())
+            m_posted.erase(it);
+        else if(exact)
+            it->second.swap(posted);
+        else
+        {
+            for(auto label : posted)
+                SortedSets::insert(it->second, label);
+        }
+        return true;
+    }
+
+    //! Adds the posting label to gv; returns false if gv already has it
+    bool post(std::size_t gv, std::size_t label_index)
+    {
+        if(!m_postings[label_index].add(gv))
+            return false;
+        SortedSets::insert(m_posted[gv], label_index);
+        return true;
+    }
+
+    //! Removes the posting label from gv, dropping gv from the posted entities with its last one; returns false if gv
+    //! does not have it
+    bool unpost(std::size_t gv, std::size_t label_index)
+    {
+        if(!m_postings[label_index].remove(gv))
+            return false;
+        auto it = m_posted.find(gv);
+        if(it != m_posted.end())
+        {
+            SortedSets::erase(it->second, label_index);
+            if(it->second.empty())
+                m_posted.erase(it);
+        }
+        return true;
+    }
+
+    //! Recomputes the posting labels of each posted entity from the postings
+    void rebuildPosted()
+    {
+        m_posted.clear();
+        std::vector<std::size_t> ids;
+        for(auto label : m_posting_labels)
+        {
+            m_postings[label].getIds(ids);
+            for(auto gv : ids)
+                m_posted[gv].push_back(label);
+        }
+    }
+
+    //! Returns the entities whose labels, pair index and postings together, are exactly the sorted labels
+    std::size_t getExactEntities(const std::vector<std::size_t> &labels, std::vector<std::size_t> &ents) const
+    {
+        ents.clear();
+        std::vector<std::size_t> tupled, posted;
+        for(auto label : labels)
+            (isPosting(label) ? posted : tupled).push_back(label);
+        if(!tupled.empty())
+        {
+            auto it = m_labels2index.find(tupled);
+            if(it == m_labels2index.end())
+                return 0;
+            m_dls.get(it->second, ents);
+        }
+        else if(!posted.empty())
+        {
+            m_postings[posted[0]].getIds(ents);
+            ents.erase(std::remove_if(ents.begin(), ents.end(), [this](std::size_t gv) { return m_dls.get_label(gv) != 0; }), ents.end());
+        }
+        else
+            return 0;
+        ents.erase(std::remove_if(ents.begin(), ents.end(), [&](std::size_t gv)
+        {
+            auto it = m_posted.find(gv);
+            return it == m_posted.end() ? !posted.empty() : it->second != posted;
+        }), ents.end());
+        return ents.size();
+    }
+
+    //! Writes the posting labels and their entity bitmaps (see LabelBitmap::write)
+    void writePostings(std::ostream &out) const
+    {
+        std::size_t vsize = m_posting_labels.size();
+        out.write((char*)&vsize, sizeof(std::size_t));
+        for(auto label : m_posting_labels)
+        {
+            out.write((char*)&label, sizeof(std::size_t));
+            m_postings[label].write(out);
+        }
+    }
+
+    //! Reads the posting labels written by writePostings
+    void readPostings(std::istream &in)
+    {
+        std::size_t vsize = 0, label = 0;
+        in.read((char*)&vsize, sizeof(std::size_t));
+        LabelBitmap posting;
+        for(std::size_t i = 0; i < vsize && in.read((char*)&label, sizeof(std::size_t)); ++i)
+        {
+            posting.read(in);
+            if(!label || !in)
+                continue;
+            if(label >= m_posting.size())
+            {
+                m_posting.resize(label+1, 0);
+                m_postings.resize(label+1);
+            }
+            m_posting[label] = 1;
+            m_postings[label] = std::move(posting);
+            SortedSets::insert(m_posting_labels, label);
+        }
+        rebuildPosted();
+    }
+
+    //! Draws k distinct positions in [0, total) uniformly (Floyd's selection) and sorts them
+    static void drawPositions(std::size_t total, std::size_t k, std::mt19937_64 &rng, std::vector<std::size_t> &positions)
+    {
+        std::unordered_set<std::size_t> chosen(2*k);
+        for(std::size_t j = total - k; j < total; ++j)
+        {
+            std::size_t t = std::uniform_int_distribution<std::size_t>(0, j)(rng);
+            if(!chosen.insert(t).second)
+                chosen.insert(j);
+        }
+        positions.assign(chosen.begin(), chosen.end());
+        std::sort(positions.begin(), positions.end());
+    }
+
+    //! Records the entity gv getting the delta tuple id, extending the last run if consecutive
+    static void appendRun(LabelDelta &delta, std::size_t gv, std::size_t tuple)
+    {
+        std::size_t n = delta.runs.size();
+        if(n && delta.runs[n-1] == tuple && delta.runs[n-2]+1 == gv)
+            delta.runs[n-2] = gv;
+        else
+        {
+            delta.runs.push_back(gv);
+            delta.runs.push_back(gv);
+            delta.runs.push_back(tuple);
+        }
+    }
+
+    //! diff over the full labels of the entities, pair index and postings together
+    static std::size_t diffLabels(const GraphLabelContainer &a, const GraphLabelContainer &b, LabelDelta &delta,
+                                  std::size_t first, std::size_t last)
+    {
+        std::size_t num_items = std::max(a.size(), b.size());
+        std::vector<std::size_t> labels_a, labels_b;
+        for(auto container : {&a, &b})
+        {
+            for(auto label : container->m_posting_labels)
+            {
+                if(container->m_postings[label].getIds(labels_a))
+                    num_items = std::max(num_items, labels_a.back());
+            }
+        }
+        last = std::min(last, num_items);
+        std::map<std::vector<std::size_t>, std::size_t> tuples;
+        std::size_t changed = 0;
+        for(std::size_t gv = std::max<std::size_t>(first, 1); gv <= last; ++gv)
+        {
+            a.getLabels(gv, labels_a);
+            b.getLabels(gv, labels_b);
+            if(labels_a == labels_b)
+                continue;
+            std::size_t tuple = 0;
+            if(!labels_b.empty())
+            {
+                auto it = tuples.insert(std::make_pair(labels_b, delta.labels_sets.size()+1));
+                if(it.second)
+                    delta.labels_sets.push_back(labels_b);
+                tuple = it.first->second;
+            }
+            appendRun(delta, gv, tuple);
+            ++changed;
+        }
+        return changed;
+    }
+
+    //! Writes the labels set of each pair index; returns false if there is none
+    static bool writeLabelsSets(std::ostream &out, const std::vector<std::vector<std::size_t>> &index2labels)
+    {
+        std::size_t header[2] = { FORMAT_MARKER, FORMAT_VERSION };
+        out.write((char*)header, sizeof(header));
+        std::size_t vsize = index2labels.size();
+        out.write((char*)&vsize, sizeof(std::size_t));
+        if(vsize==0)
+            return false;
+        for(std::size_t index = 0; index < index2labels.size(); ++index)
+        {
+            vsize = index2labels[index].size();
+            out.write((char*)&vsize,sizeof(std::size_t));
+            if(vsize ==  0)
+                continue;            
+            out.write((char*)&index2labels[index][0], sizeof(std::size_t)*vsize);
+        }
+        return true;
+    }
+
+    //! Reads the format header and the labels set of each pair index; version is 0 for a stream written before the
+    //! format marker. Returns false if there is no labels set or the version is newer than FORMAT_VERSION (failbit set)
+    static bool readLabelsSets(std::istream &in, std::vector<std::vector<std::size_t>> &index2labels, std::size_t &version)
+    {
+        std::size_t vsize = 0;
+        version = 0;
+        in.read((char*)&vsize, sizeof(std::size_t));
+        if(in && vsize == FORMAT_MARKER)
+        {
+            in.read((char*)&version, sizeof(std::size_t));
+            if(version > FORMAT_VERSION)
+                in.setstate(std::ios::failbit);
+            in.read((char*)&vsize, sizeof(std::size_t));
+        }
+        if(!in || vsize == 0)
+            return false;
+        index2labels.resize(vsize);
+        for(std::size_t i = 0; i < index2labels.size(); ++i)
+        {             
+            in.read((char*)&vsize, sizeof(std::size_t));
+            if(vsize == 0)
+                continue;
+            index2labels[i].resize(vsize);         
+            in.read((char*)&index2labels[i][0], vsize*sizeof(std::size_t));
+        }
+        return bool(in);
+    }
+
+    //! Rebuilds m_labels2index and m_label2indexes from m_index2labels. The pair indexes are sorted by labels set in
+    //! num_threads ranges in parallel and merged so that the map is filled in key order (amortized constant inserts)
+    void rebuildIndexes(std::size_t num_threads = 1)
+    {
+        std::size_t num_indexes = m_index2labels.empty() ? 0 : m_index2labels.size()-1;
+        std::vector<std::size_t> order(num_indexes);
+        std::iota(order.begin(), order.end(), 1);
+        auto less = [this](std::size_t a, std::size_t b) { return m_index2labels[a] < m_index2labels[b]; };
+        num_threads = std::max<std::size_t>(1, std::min(num_threads, num_indexes/1024));
+        std::vector<std::size_t> bounds;
+        for(std::size_t t = 0; t <= num_threads; ++t)
+            bounds.push_back(t*num_indexes/num_threads);
+        LabelFile::parallelFor(num_threads, num_threads, [&](std::size_t t)
+        {
+            std::stable_sort(order.begin() + bounds[t], order.begin() + bounds[t+1], less);
+        });
+        for(std::size_t width = 1; width < num_threads; width *= 2)
+        {
+            for(std::size_t t = 0; t + width < num_threads; t += 2*width)
+                std::inplace_merge(order.begin() + bounds[t], order.begin() + bounds[t+width],
+                                   order.begin() + bounds[std::min(t + 2*width, num_threads)], less);
+        }
+        // equal (empty) labels sets keep the smallest pair index as the sequential inserts did
+        for(auto index : order)
+            m_labels2index.emplace_hint(m_labels2index.end(), m_index2labels[index], index);
+        for(std::size_t index = 1; index < m_index2labels.size(); ++index)
+        {            
+            for(auto label : m_index2labels[index])
+            {                                
+                if(label >= m_label2indexes.size())
+                    m_label2indexes.resize(label+1);
+                m_label2indexes[label].push_back(index);
+            }            
+        }  
+    }
+
+    //! Rebuilds the hierarchy closures, the co-occurrences and the standing query results after a read
+    void rebuildDerived()
+    {
+        updateHierarchy();
+        for(std::size_t index = 1; index < m_index2labels.size(); ++index)
+            touchCooccurrence(index);
+        for(auto &query : m_queries)
+        {
+            if(query.active)
+                evaluateQuery(query);
+        }
+    }
+
+    //! Moves the entity gv from its current pair index to pair_index (0 removes it); all entity moves go through here
+    void moveEntity(std::size_t gv, std::size_t pair_index)
+    {
+        std::size_t old_index = m_dls.get_label(gv);
+        if(old_index == pair_index)
+            return;
+        if(pair_index)
+            m_dls.insert(gv,pair_index);
+        else
+            m_dls.del_item(gv);
+        touchCooccurrence(old_index);
+        touchCooccurrence(pair_index);
+        if(!m_bitmaps.empty())
+        {
+            invalidateBitmaps(old_index);
+            invalidateBitmaps(pair_index);
+        }
+        for(auto &query : m_queries)
+        {
+            bool from = isMatch(query, old_index), to = isMatch(query, pair_index);
+            if(from != to)
+                pushDelta(query, gv, to);
+        }
+        for(auto &listener : m_listeners)
+        {
+            if(listener)
+                listener(&gv, 1, old_index, pair_index);
+        }
+    }
+
+    //! Moves the entities gvs all having pair index old_index to pair_index in bulk (0 removes them)
+    void moveEntities(const std::vector<std::size_t> &gvs, std::size_t old_index, std::size_t pair_index)
+    {
+        if(old_index == pair_index || gvs.empty())
+            return;
+        m_dls.move(gvs, old_index, pair_index);
+        touchCooccurrence(old_index);
+        touchCooccurrence(pair_index);
+        if(!m_bitmaps.empty())
+        {
+            invalidateBitmaps(old_index);
+            invalidateBitmaps(pair_index);
+        }
+        for(auto &query : m_queries)
+        {
+            bool from = isMatch(query, old_index), to = isMatch(query, pair_index);
+            if(from == to)
+                continue;
+            for(auto gv : gvs)
+                pushDelta(query, gv, to);
+        }
+        for(auto &listener : m_listeners)
+        {
+            if(listener)
+                listener(gvs.data(), gvs.size(), old_index, pair_index);
+        }
+    }
+
+    //! Returns true if the labels set of the pair index matches the standing query
+    static bool isMatch(const StandingQuery &query, std::size_t pair_index)
+    {
+        return query.active && pair_index < query.matches.size() && query.matches[pair_index];
+    }
+
+    static void setMatch(StandingQuery &query, std::size_t pair_index, bool match)
+    {
+        if(pair_index >= query.matches.size())
+            query.matches.resize(pair_index+1, 0);
+        query.matches[pair_index] = match;
+    }
+
+    //! Records that the entity entered/left the result of the standing query
+    static void pushDelta(StandingQuery &query, std::size_t gv, bool entered)
+    {
+        if(entered)
+        {
+            query.result.add(gv);
+            query.count++;
+        }
+        else
+        {
+            query.result.remove(gv);
+            query.count--;
+        }
+        query.deltas.push_back({gv, entered});
+    }
+
+    //! Evaluates the standing query for all pair indexes and collects its result
+    void evaluateQuery(StandingQuery &query) const
+    {
+        query.matches.assign(m_index2labels.size(), 0);
+        for(std::size_t index = 1; index < m_index2labels.size(); ++index)
+        {
+            if(!m_index2labels[index].empty())
+                query.matches[index] = query.expr.evaluate(m_index2labels[index]);
+        }
+        seedQuery(query);
+    }
+
+    //! Collects the result of the standing query from its matching pair indexes
+    void seedQuery(StandingQuery &query) const
+    {
+        query.result.clear();
+        for(std::size_t index = 1; index < query.matches.size(); ++index)
+        {
+            if(query.matches[index])
+                getIndexEntities(index, query.result);
+        }
+        query.count = query.result.cardinality();
+    }
+
+    //! Groups the entities by pair index, resolves the transition once per group and moves the group in bulk
+    void moveGroups(const std::vector<std::size_t> &gvs, std::size_t label_index, bool del)
+    {
+        std::vector<std::pair<std::size_t, std::size_t>> groups(gvs.size());
+        for(std::size_t i = 0; i < gvs.size(); ++i)
+            groups[i] = std::make_pair(m_dls.get_label(gvs[i]), gvs[i]);
+        std::sort(groups.begin(), groups.end());
+        groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+        std::vector<std::size_t> items;
+        for(std::size_t first = 0; first < groups.size(); )
+        {
+            std::size_t old_index = groups[first].first;
+            std::size_t last = first;
+            items.clear();
+            while(last < groups.size() && groups[last].first == old_index)
+                items.push_back(groups[last++].second);
+            first = last;
+            if(!old_index && del)
+                continue;
+            std::size_t pair_index = transition(old_index, label_index, del);
+            moveEntities(items, old_index, pair_index);
+            if(old_index && old_index != pair_index)
+                recycle(old_index);
+        }
+    }
+
+    //! Returns the number of times a pair index is recycled
+    std::size_t generation(std::size_t pair_index) const
+    {
+        return (pair_index < m_generations.size()) ? m_generations[pair_index] : 0;
+    }
+
+    //! Drops the cached bitmaps of the labels of a pair index
+    void invalidateBitmaps(std::size_t pair_index) const
+    {
+        if(!pair_index || pair_index >= m_index2labels.size())
+            return;
+        for(auto label : m_index2labels[pair_index])
+            m_bitmaps.erase(label);
+    }
+
+    //! Adds the entities of a pair index into the bitmap
+    void getIndexEntities(std::size_t pair_index, LabelBitmap &ents) const
+    {
+        std::vector<std::size_t> chained;
+        m_dls.visit(pair_index, [&chained](std::size_t item) { chained.push_back(item); },
+                    [&ents](std::size_t first, std::size_t last) { ents.addRange(first, last); });
+        ents.add(chained);
+    }
+
+    //! Marks the entity count of a pair index as changed for the co-occurrence graph
+    void touchCooccurrence(std::size_t pair_index) const
+    {
+        if(!pair_index)
+            return;
+        if(pair_index >= m_cooc_flags.size())
+            m_cooc_flags.resize(pair_index+1, 0);
+        if(!m_cooc_flags[pair_index])
+        {
+            m_cooc_flags[pair_index] = 1;
+            m_cooc_dirty.push_back(pair_index);
+        }
+    }
+
+    //! Accounts the entity count change of a pair index in the label co-occurrence weights
+    void syncCooccurrence(std::size_t pair_index) const
+    {
+        if(pair_index >= m_cooc_counts.size())
+            m_cooc_counts.resize(pair_index+1, 0);
+        std::size_t count = m_dls.count(pair_index);
+        std::size_t delta = count - m_cooc_counts[pair_index]; // modular; may wrap for decrements
+        m_cooc_counts[pair_index] = count;
+        if(!delta || pair_index >= m_index2labels.size())
+            return;
+        const std::vector<std::size_t> &labels = m_index2labels[pair_index];
+        if(!labels.empty() && labels.back() >= m_cooc.size())
+            m_cooc.resize(labels.back()+1);
+        for(std::size_t i = 0; i < labels.size(); ++i)
+        {
+            std::map<std::size_t, std::size_t> &row = m_cooc[labels[i]];
+            for(std::size_t j = i; j < labels.size(); ++j)
+            {
+                std::size_t &weight = row[labels[j]];
+                weight += delta;
+                if(!weight)
+                    row.erase(labels[j]);
+            }
+        }
+    }
+
+    //! Returns the co-occurrence rows (see m_cooc) with the weights of the posting labels added in merged, or m_cooc
+    //! itself if there is no posting label. The posted entities are visited once: their posting label pairs are counted
+    //! directly and their (posting label, pair index) counts are spread over the labels of the pair indexes. The
+    //! caller holds m_sync
+    const std::vector<std::map<std::size_t, std::size_t>> &getCooccurrenceRows(std::vector<std::map<std::size_t, std::size_t>> &merged) const
+    {
+        if(m_posting_labels.empty())
+            return m_cooc;
+        merged = m_cooc;
+        auto add = [&merged](std::size_t a, std::size_t b, std::size_t weight)
+        {
+            if(a > b)
+                std::swap(a, b);
+            if(a >= merged.size())
+                merged.resize(a+1);
+            merged[a][b] += weight;
+        };
+        std::map<std::pair<std::size_t, std::size_t>, std::size_t> index_counts; //- (posting label, pair index) --> entities
+        for(const auto &pr : m_posted)
+        {
+            const std::vector<std::size_t> &labels = pr.second;
+            std::size_t pair_index = m_dls.get_label(pr.first);
+            for(std::size_t i = 0; i < labels.size(); ++i)
+            {
+                if(pair_index)
+                    index_counts[std::make_pair(labels[i], pair_index)]++;
+                for(std::size_t j = i; j < labels.size(); ++j)
+                    add(labels[i], labels[j], 1);
+            }
+        }
+        for(const auto &it : index_counts)
+        {
+            if(it.first.second >= m_index2labels.size())
+                continue;
+            for(auto label : m_index2labels[it.first.second])
+                add(it.first.first, label, it.second);
+        }
+        return merged;
+    }
+
+    //! Accounts all dirty pair indexes in the label co-occurrence weights; the const callers hold m_sync
+    void syncCooccurrence() const
+    {
+        for(auto pair_index : m_cooc_dirty)
+        {
+            syncCooccurrence(pair_index);
+            m_cooc_flags[pair_index] = 0;
+        }
+        m_cooc_dirty.clear();
+    }
+
+    //! Adds the pair index into the closures of the ancestors of its labels
+    void insertClosure(const std::vector<std::size_t> &labels, std::size_t pair_index)
+    {
+        for(auto label : labels)
+        {
+            if(label >= m_subsumers.size())
+                continue;
+            for(auto ancestor : m_subsumers[label])
+            {
+                SortedSets::insert(m_label2closure[ancestor], pair_index);
+            }
+        }
+    }
+
+    //! Removes the pair index from the closures of the ancestors of its labels
+    void eraseClosure(const std::vector<std::size_t> &labels, std::size_t pair_index)
+    {
+        for(auto label : labels)
+        {
+            if(label >= m_subsumers.size())
+                continue;
+            for(auto ancestor : m_subsumers[label])
+            {
+                SortedSets::erase(m_label2closure[ancestor], pair_index);
+            }
+        }
+    }
+
+    //! Recomputes the subsumers of each label and rebuilds the closures from m_label2indexes
+    void updateHierarchy()
+    {
+        m_subsumers.assign(m_parents.size(), std::vector<std::size_t>());
+        m_label2closure.assign(m_parents.size(), std::vector<std::size_t>());
+        for(std::size_t label = 0; label < m_parents.size(); ++label)
+        {
+            for(std::size_t ancestor = 0; ancestor < m_parents.size(); ++ancestor)
+            {
+                if(ancestor != label && isA(label, ancestor))
+                    m_subsumers[label].push_back(ancestor);
+            }
+        }
+        // a label with sub-labels subsumes itself
+        for(std::size_t label = 0; label < m_parents.size(); ++label)
+        {
+            for(auto parent : m_parents[label])
+            {
+                SortedSets::insert(m_subsumers[parent], parent);
+            }
+        }
+        for(std::size_t label = 0; label < m_subsumers.size() && label < m_label2indexes.size(); ++label)
+        {
+            for(auto ancestor : m_subsumers[label])
+            {
+                std::vector<std::size_t> merged;
+                SortedSets::unite(m_label2closure[ancestor], m_label2indexes[label], merged);
+                m_label2closure[ancestor].swap(merged);
+            }
+        }
+    }
+
 };
 
 
@@ -0,0 +1,641 @@
+#ifndef __LABELBITMAP_H__
+#define __LABELBITMAP_H__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <iostream>
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Compressed bitmap of entity ids in the spirit of roaring bitmaps used as label query result sets
+/// The id space is split into chunks of 2^16 ids keyed by the high bits (id >> 16); each non-empty chunk has a container:
+/// - an array container: sorted 16 bit low ids when the chunk has at most 4096 ids
+/// - a bitset container: 1024 64-bit words otherwise
+/// The containers switch representation after each operation so that the smaller one is kept.
+/// AND/OR/ANDNOT between bitset containers are plain word loops that the compiler vectorizes;
+/// the array containers are merged.
+/// Ids come out sorted which makes intersections with traversal frontiers or SQL filters merge friendly.
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+class LabelBitmap {
+public:
+    enum
+    {
+        CHUNK_BITS = 16,
+        CHUNK_SIZE = 1 << CHUNK_BITS,
+        NUM_WORDS  = CHUNK_SIZE/64,
+        MAX_ARRAY  = 4096
+    };
+
+protected:
+    struct Container
+    {
+        std::vector<std::uint16_t> array; //- sorted low ids if an array container
+        std::vector<std::uint64_t> bits;  //- NUM_WORDS words if a bitset container
+        std::size_t                card;  //- number of ids
+
+        Container() : card(0) {}
+        bool is_bitset() const { return !bits.empty(); }
+    };
+
+    std::vector<std::size_t> m_keys;       //- sorted chunk keys (id >> CHUNK_BITS)
+    std::vector<Container>   m_containers; //- container of each chunk key
+
+public:
+    //! C'tor
+    LabelBitmap() {}
+
+    //! C'tor from a list of ids (need not be sorted)
+    explicit LabelBitmap(const std::vector<std::size_t> &ids)
+    {
+        add(ids);
+    }
+
+    //! Clears all
+    void clear()
+    {
+        m_keys.clear();
+        m_containers.clear();
+    }
+
+    //! Returns true if there is no id
+    bool empty() const
+    {
+        return m_keys.empty();
+    }
+
+    //! Returns the number of ids
+    std::size_t cardinality() const
+    {
+        std::size_t total = 0;
+        for(const auto &c : m_containers)
+            total += c.card;
+        return total;
+    }
+
+    //! Adds an id; returns false if it already exists
+    bool add(std::size_t id)
+    {
+        Container &c = container(id >> CHUNK_BITS);
+        std::uint16_t low = std::uint16_t(id & (CHUNK_SIZE-1));
+        if(c.is_bitset())
+        {
+            std::uint64_t mask = std::uint64_t(1) << (low & 63);
+            if(c.bits[low >> 6] & mask)
+                return false;
+            c.bits[low >> 6] |= mask;
+            c.card++;
+            return true;
+        }
+        auto it = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if(it != c.array.end() && *it == low)
+            return false;
+        c.array.insert(it, low);
+        c.card++;
+        if(c.card > MAX_ARRAY)
+            to_bitset(c);
+        return true;
+    }
+
+    //! Adds a list of ids (need not be sorted); the ids are sorted once and merged chunk by chunk
+    void add(const std::vector<std::size_t> &ids)
+    {
+        const std::vector<std::size_t> *sorted = &ids;
+        std::vector<std::size_t> copy;
+        if(!std::is_sorted(ids.begin(), ids.end()))
+        {
+            copy = ids;
+            std::sort(copy.begin(), copy.end());
+            sorted = &copy;
+        }
+        Container chunk;
+        for(std::size_t i = 0; i < sorted->size(); )
+        {
+            std::size_t key = (*sorted)[i] >> CHUNK_BITS;
+            chunk.array.clear();
+            chunk.bits.clear();
+            for(; i < sorted->size() && ((*sorted)[i] >> CHUNK_BITS) == key; ++i)
+            {
+                std::uint16_t low = std::uint16_t((*sorted)[i] & (CHUNK_SIZE-1));
+                if(chunk.array.empty() || chunk.array.back() != low)
+                    chunk.array.push_back(low);
+            }
+            chunk.card = chunk.array.size();
+            if(chunk.card > MAX_ARRAY)
+                to_bitset(chunk);
+            unite(container(key), chunk);
+        }
+    }
+
+    //! Adds the ids first..last (inclusive)
+    void addRange(std::size_t first, std::size_t last)
+    {
+        while(first <= last)
+        {
+            std::size_t key = first >> CHUNK_BITS;
+            std::size_t chunk_last = std::min(last, ((key+1) << CHUNK_BITS) - 1);
+            Container &c = container(key);
+            std::size_t lo = first & (CHUNK_SIZE-1), hi = chunk_last & (CHUNK_SIZE-1);
+            if(!c.is_bitset() && c.card + (hi-lo+1) <= MAX_ARRAY)
+            {
+                std::vector<std::uint16_t> range(hi-lo+1), merged;
+                for(std::size_t i = lo; i <= hi; ++i)
+                    range[i-lo] = std::uint16_t(i);
+                std::set_union(c.array.begin(), c.array.end(), range.begin(), range.end(), std::back_inserter(merged));
+                c.array.swap(merged);
+                c.card = c.array.size();
+            }
+            else
+            {
+                to_bitset(c);
+                set_bits(c.bits, lo, hi);
+                c.card = popcount(c.bits);
+                if(c.card <= MAX_ARRAY)
+                    to_array(c);
+            }
+            if(chunk_last == last)
+                break;
+            first = chunk_last+1;
+        }
+    }
+
+    //! Removes an id; returns false if it does not exist
+    bool remove(std::size_t id)
+    {
+        std::size_t pos = find(id >> CHUNK_BITS);
+        if(pos == m_keys.size())
+            return false;
+        Container &c = m_containers[pos];
+        std::uint16_t low = std::uint16_t(id & (CHUNK_SIZE-1));
+        if(c.is_bitset())
+        {
+            std::uint64_t mask = std::uint64_t(1) << (low & 63);
+            if(!(c.bits[low >> 6] & mask))
+                return false;
+            c.bits[low >> 6] &= ~mask;
+            c.card--;
+        }
+        else
+        {
+            auto it = std::lower_bound(c.array.begin(), c.array.end(), low);
+            if(it == c.array.end() || *it != low)
+                return false;
+            c.array.erase(it);
+            c.card--;
+        }
+        normalize(pos);
+        return true;
+    }
+
+    //! Returns true if the id exists
+    bool contains(std::size_t id) const
+    {
+        std::size_t pos = find(id >> CHUNK_BITS);
+        if(pos == m_keys.size())
+            return false;
+        const Container &c = m_containers[pos];
+        std::uint16_t low = std::uint16_t(id & (CHUNK_SIZE-1));
+        if(c.is_bitset())
+            return (c.bits[low >> 6] >> (low & 63)) & 1;
+        return std::binary_search(c.array.begin(), c.array.end(), low);
+    }
+
+    //! Returns the sorted ids; at most limit of them are appended
+    std::size_t getIds(std::vector<std::size_t> &ids, bool clear = true, std::size_t limit = std::size_t(-1)) const
+    {
+        if(clear)
+            ids.clear();
+        std::size_t end = (limit < std::size_t(-1) - ids.size()) ? ids.size() + limit : std::size_t(-1);
+        for(std::size_t pos = 0; pos < m_keys.size() && ids.size() < end; ++pos)
+        {
+            std::size_t base = m_keys[pos] << CHUNK_BITS;
+            const Container &c = m_containers[pos];
+            if(!c.is_bitset())
+            {
+                for(std::size_t i = 0; i < c.array.size() && ids.size() < end; ++i)
+                    ids.push_back(base + c.array[i]);
+                continue;
+            }
+            for(std::size_t w = 0; w < NUM_WORDS && ids.size() < end; ++w)
+            {
+                std::uint64_t word = c.bits[w];
+                while(word && ids.size() < end)
+                {
+                    ids.push_back(base + 64*w + __builtin_ctzll(word));
+                    word &= word-1;
+                }
+            }
+        }
+        return ids.size();
+    }
+
+    //! Appends the ids at the sorted ranks (< cardinality) in the order of getIds; the containers before a rank are
+    //! skipped by their cardinalities and the bitset words by their popcounts. Returns the number of appended ids
+    std::size_t select(const std::vector<std::size_t> &ranks, std::vector<std::size_t> &ids) const
+    {
+        std::size_t r = 0, offset = 0;
+        for(std::size_t pos = 0; pos < m_keys.size() && r < ranks.size(); ++pos)
+        {
+            const Container &c = m_containers[pos];
+            std::size_t base = m_keys[pos] << CHUNK_BITS;
+            if(!c.is_bitset())
+            {
+                for(; r < ranks.size() && ranks[r] < offset + c.card; ++r)
+                    ids.push_back(base + c.array[ranks[r] - offset]);
+            }
+            else
+            {
+                for(std::size_t w = 0, before = offset; w < NUM_WORDS && r < ranks.size() && ranks[r] < offset + c.card; ++w)
+                {
+                    std::uint64_t word = c.bits[w];
+                    std::size_t n = __builtin_popcountll(word);
+                    for(; r < ranks.size() && ranks[r] < before + n; ++r)
+                    {
+                        // drop the lower set bits up to the rank
+                        std::uint64_t bits = word;
+                        for(std::size_t i = before; i < ranks[r]; ++i)
+                            bits &= bits-1;
+                        ids.push_back(base + 64*w + __builtin_ctzll(bits));
+                    }
+                    before += n;
+                }
+            }
+            offset += c.card;
+        }
+        return r;
+    }
+
+    //! Intersection in place
+    LabelBitmap &andWith(const LabelBitmap &other)
+    {
+        std::size_t out = 0;
+        for(std::size_t pos = 0, opos = 0; pos < m_keys.size() && opos < other.m_keys.size(); )
+        {
+            if(m_keys[pos] < other.m_keys[opos])
+                ++pos;
+            else if(m_keys[pos] > other.m_keys[opos])
+                ++opos;
+            else
+            {
+                intersect(m_containers[pos], other.m_containers[opos]);
+                if(m_containers[pos].card)
+                {
+                    m_keys[out] = m_keys[pos];
+                    if(out != pos)
+                        m_containers[out] = std::move(m_containers[pos]);
+                    ++out;
+                }
+                ++pos;
+                ++opos;
+            }
+        }
+        m_keys.resize(out);
+        m_containers.resize(out);
+        return *this;
+    }
+
+    //! Union in place
+    LabelBitmap &orWith(const LabelBitmap &other)
+    {
+        for(std::size_t opos = 0; opos < other.m_keys.size(); ++opos)
+        {
+            Container &c = container(other.m_keys[opos]);
+            unite(c, other.m_containers[opos]);
+        }
+        return *this;
+    }
+
+    //! Difference in place; removes the ids of other
+    LabelBitmap &andNotWith(const LabelBitmap &other)
+    {
+        std::size_t out = 0;
+        for(std::size_t pos = 0, opos = 0; pos < m_keys.size(); ++pos)
+        {
+            while(opos < other.m_keys.size() && other.m_keys[opos] < m_keys[pos])
+                ++opos;
+            if(opos < other.m_keys.size() && other.m_keys[opos] == m_keys[pos])
+                subtract(m_containers[pos], other.m_containers[opos]);
+            if(m_containers[pos].card)
+            {
+                m_keys[out] = m_keys[pos];
+                if(out != pos)
+                    m_containers[out] = std::move(m_containers[pos]);
+                ++out;
+            }
+        }
+        m_keys.resize(out);
+        m_containers.resize(out);
+        return *this;
+    }
+
+    //! Returns the number of common ids w/o materializing the intersection
+    std::size_t andCardinality(const LabelBitmap &other) const
+    {
+        std::size_t total = 0;
+        for(std::size_t pos = 0, opos = 0; pos < m_keys.size() && opos < other.m_keys.size(); )
+        {
+            if(m_keys[pos] < other.m_keys[opos])
+                ++pos;
+            else if(m_keys[pos] > other.m_keys[opos])
+                ++opos;
+            else
+            {
+                Container c = m_containers[pos];
+                intersect(c, other.m_containers[opos]);
+                total += c.card;
+                ++pos;
+                ++opos;
+            }
+        }
+        return total;
+    }
+
+    bool operator==(const LabelBitmap &other) const
+    {
+        if(m_keys != other.m_keys)
+            return false;
+        for(std::size_t pos = 0; pos < m_keys.size(); ++pos)
+        {
+            const Container &a = m_containers[pos], &b = other.m_containers[pos];
+            if(a.card != b.card || a.array != b.array || a.bits != b.bits)
+                return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const LabelBitmap &other) const
+    {
+        return !(*this == other);
+    }
+
+    //! Serialized write to a binary output stream: the number of containers, then the key, cardinality and kind
+    //! (0 array, 1 bitset) of each container followed by its low ids or its words
+    void write(std::ostream &out) const
+    {
+        std::size_t vsize = m_keys.size();
+        out.write((char*)&vsize, sizeof(std::size_t));
+        for(std::size_t pos = 0; pos < m_keys.size(); ++pos)
+        {
+            const Container &c = m_containers[pos];
+            std::size_t header[3] = { m_keys[pos], c.card, c.is_bitset() ? std::size_t(1) : std::size_t(0) };
+            out.write((char*)header, sizeof(header));
+            if(c.is_bitset())
+                out.write((char*)&c.bits[0], NUM_WORDS*sizeof(std::uint64_t));
+            else
+                out.write((char*)&c.array[0], c.card*sizeof(std::uint16_t));
+        }
+    }
+
+    //! Serialized read from a binary input stream written by write; sets the failbit on a malformed container
+    void read(std::istream &in)
+    {
+        clear();
+        std::size_t vsize = 0;
+        if(!in.read((char*)&vsize, sizeof(std::size_t)))
+            return;
+        for(std::size_t i = 0; i < vsize; ++i)
+        {
+            std::size_t header[3] = { 0, 0, 0 };
+            if(!in.read((char*)header, sizeof(header)))
+                break;
+            if(!header[1] || header[1] > CHUNK_SIZE || header[2] > 1 || (!header[2] && header[1] > MAX_ARRAY) ||
+               (!m_keys.empty() && header[0] <= m_keys.back()))
+            {
+                in.setstate(std::ios::failbit);
+                break;
+            }
+            m_keys.push_back(header[0]);
+            m_containers.push_back(Container());
+            Container &c = m_containers.back();
+            c.card = header[1];
+            if(header[2])
+            {
+                c.bits.resize(NUM_WORDS);
+                in.read((char*)&c.bits[0], NUM_WORDS*sizeof(std::uint64_t));
+            }
+            else
+            {
+                c.array.resize(c.card);
+                in.read((char*)&c.array[0], c.card*sizeof(std::uint16_t));
+            }
+        }
+        if(!in)
+            clear();
+    }
+
+    //! Returns the memory occupied (in bytes)
+    std::size_t memory() const
+    {
+        std::size_t total = sizeof(LabelBitmap) + m_keys.capacity()*sizeof(std::size_t) + m_containers.capacity()*sizeof(Container);
+        for(const auto &c : m_containers)
+            total += c.array.capacity()*sizeof(std::uint16_t) + c.bits.capacity()*sizeof(std::uint64_t);
+        return total;
+    }
+
+    //! Prints all
+    void print(std::ostream &out = std::cout) const
+    {
+        std::vector<std::size_t> ids;
+        getIds(ids);
+        out << "Bitmap (" << ids.size() << "):";
+        for(auto id : ids)
+            out << " " << id;
+        out << std::endl;
+    }
+
+protected:
+    //! Returns the position of the key or the number of keys if not found
+    std::size_t find(std::size_t key) const
+    {
+        auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+        return (it != m_keys.end() && *it == key) ? std::size_t(it - m_keys.begin()) : m_keys.size();
+    }
+
+    //! Returns the container of the key; creates an empty one if not found
+    Container &container(std::size_t key)
+    {
+        auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+        std::size_t pos = it - m_keys.begin();
+        if(it == m_keys.end() || *it != key)
+        {
+            m_keys.insert(it, key);
+            m_containers.insert(m_containers.begin()+pos, Container());
+        }
+        return m_containers[pos];
+    }
+
+    //! Keeps the smaller representation; removes the container if empty
+    void normalize(std::size_t pos)
+    {
+        Container &c = m_containers[pos];
+        if(!c.card)
+        {
+            m_keys.erase(m_keys.begin()+pos);
+            m_containers.erase(m_containers.begin()+pos);
+        }
+        else if(c.is_bitset() && c.card <= MAX_ARRAY)
+            to_array(c);
+    }
+
+    static std::size_t popcount(const std::vector<std::uint64_t> &bits)
+    {
+        std::size_t card = 0;
+        for(std::size_t w = 0; w < NUM_WORDS; ++w)
+            card += __builtin_popcountll(bits[w]);
+        return card;
+    }
+
+    static void set_bits(std::vector<std::uint64_t> &bits, std::size_t lo, std::size_t hi)
+    {
+        for(std::size_t w = lo >> 6; w <= (hi >> 6); ++w)
+        {
+            std::size_t b0 = (w == (lo >> 6)) ? (lo & 63) : 0;
+            std::size_t b1 = (w == (hi >> 6)) ? (hi & 63) : 63;
+            std::uint64_t mask = (b1 - b0 == 63) ? ~std::uint64_t(0) : (((std::uint64_t(1) << (b1-b0+1)) - 1) << b0);
+            bits[w] |= mask;
+        }
+    }
+
+    static void to_bitset(Container &c)
+    {
+        if(c.is_bitset())
+            return;
+        c.bits.assign(NUM_WORDS, 0);
+        for(auto low : c.array)
+            c.bits[low >> 6] |= std::uint64_t(1) << (low & 63);
+        std::vector<std::uint16_t>().swap(c.array);
+    }
+
+    static void to_array(Container &c)
+    {
+        if(!c.is_bitset())
+            return;
+        c.array.clear();
+        c.array.reserve(c.card);
+        for(std::size_t w = 0; w < NUM_WORDS; ++w)
+        {
+            std::uint64_t word = c.bits[w];
+            while(word)
+            {
+                c.array.push_back(std::uint16_t(64*w + __builtin_ctzll(word)));
+                word &= word-1;
+            }
+        }
+        std::vector<std::uint64_t>().swap(c.bits);
+    }
+
+    static void intersect(Container &c, const Container &o)
+    {
+        if(c.is_bitset() && o.is_bitset())
+        {
+            std::uint64_t *a = &c.bits[0];
+            const std::uint64_t *b = &o.bits[0];
+            for(std::size_t w = 0; w < NUM_WORDS; ++w)
+                a[w] &= b[w];
+            c.card = popcount(c.bits);
+            if(c.card <= MAX_ARRAY)
+                to_array(c);
+            return;
+        }
+        if(c.is_bitset())
+        {
+            // the result is at most the array of o
+            std::vector<std::uint16_t> array;
+            for(auto low : o.array)
+            {
+                if((c.bits[low >> 6] >> (low & 63)) & 1)
+                    array.push_back(low);
+            }
+            std::vector<std::uint64_t>().swap(c.bits);
+            c.array.swap(array);
+        }
+        else if(o.is_bitset())
+        {
+            std::size_t n = 0;
+            for(auto low : c.array)
+            {
+                if((o.bits[low >> 6] >> (low & 63)) & 1)
+                    c.array[n++] = low;
+            }
+            c.array.resize(n);
+        }
+        else
+        {
+            std::vector<std::uint16_t> array;
+            std::set_intersection(c.array.begin(), c.array.end(), o.array.begin(), o.array.end(), std::back_inserter(array));
+            c.array.swap(array);
+        }
+        c.card = c.array.size();
+    }
+
+    static void unite(Container &c, const Container &o)
+    {
+        if(!c.is_bitset() && !o.is_bitset() && c.card + o.card <= MAX_ARRAY)
+        {
+            std::vector<std::uint16_t> array;
+            std::set_union(c.array.begin(), c.array.end(), o.array.begin(), o.array.end(), std::back_inserter(array));
+            c.array.swap(array);
+            c.card = c.array.size();
+            return;
+        }
+        to_bitset(c);
+        if(o.is_bitset())
+        {
+            std::uint64_t *a = &c.bits[0];
+            const std::uint64_t *b = &o.bits[0];
+            for(std::size_t w = 0; w < NUM_WORDS; ++w)
+                a[w] |= b[w];
+        }
+        else
+        {
+            for(auto low : o.array)
+                c.bits[low >> 6] |= std::uint64_t(1) << (low & 63);
+        }
+        c.card = popcount(c.bits);
+        if(c.card <= MAX_ARRAY)
+            to_array(c);
+    }
+
+    static void subtract(Container &c, const Container &o)
+    {
+        if(c.is_bitset())
+        {
+            if(o.is_bitset())
+            {
+                std::uint64_t *a = &c.bits[0];
+                const std::uint64_t *b = &o.bits[0];
+                for(std::size_t w = 0; w < NUM_WORDS; ++w)
+                    a[w] &= ~b[w];
+            }
+            else
+            {
+                for(auto low : o.array)
+                    c.bits[low >> 6] &= ~(std::uint64_t(1) << (low & 63));
+            }
+            c.card = popcount(c.bits);
+            if(c.card <= MAX_ARRAY)
+                to_array(c);
+            return;
+        }
+        if(o.is_bitset())
+        {
+            std::size_t n = 0;
+            for(auto low : c.array)
+            {
+                if(!((o.bits[low >> 6] >> (low & 63)) & 1))
+                    c.array[n++] = low;
+            }
+            c.array.resize(n);
+        }
+        else
+        {
+            std::vector<std::uint16_t> array;
+            std::set_difference(c.array.begin(), c.array.end(), o.array.begin(), o.array.end(), std::back_inserter(array));
+            c.array.swap(array);
+        }
+        c.card = c.array.size();
+    }
+};
+
+#endif
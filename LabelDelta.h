@@ -0,0 +1,70 @@
+#ifndef __LABELDELTA_H__
+#define __LABELDELTA_H__
+
+#include <vector>
+#include <iostream>
+#include "SingleDLS.h"
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Changes that turn the entity labels of one GraphLabelContainer into those of another (see GraphLabelContainer::diff)
+/// The delta does not depend on the pair index numbering of either container:
+///   labels_sets : dictionary of the labels sets the changed entities get; delta tuple id t refers to labels_sets[t-1]
+///   runs        : sorted (first entity, last entity, delta tuple id) triplets of consecutive changed entities
+///                 getting the same labels set; delta tuple id 0 removes the labels of the entities
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+struct LabelDelta
+{
+    std::vector<std::vector<std::size_t>> labels_sets;
+    std::vector<std::size_t>              runs;
+
+    void clear()
+    {
+        labels_sets.clear();
+        runs.clear();
+    }
+
+    bool empty() const
+    {
+        return runs.empty();
+    }
+
+    //! Returns the number of changed entities
+    std::size_t size() const
+    {
+        std::size_t n = 0;
+        for(std::size_t i = 0; i < runs.size(); i = i+3)
+            n += runs[i+1] - runs[i] + 1;
+        return n;
+    }
+
+    //! Serialized write to a binary output stream
+    void write(std::ostream &out) const
+    {
+        std::size_t vsize = labels_sets.size();
+        out.write((char*)&vsize, sizeof(std::size_t));
+        for(auto &labels : labels_sets)
+            SingleDLS::write(out, labels);
+        SingleDLS::write(out, runs);
+    }
+
+    //! Serialized read from a binary input stream
+    void read(std::istream &in)
+    {
+        clear();
+        std::size_t vsize = 0;
+        in.read((char*)&vsize, sizeof(std::size_t));
+        labels_sets.resize(in ? vsize : 0);
+        for(auto &labels : labels_sets)
+            SingleDLS::read(in, labels);
+        SingleDLS::read(in, runs);
+    }
+
+    //! Returns the memory occupied
+    std::size_t memory() const
+    {
+        return SingleDLS::memory(labels_sets) + SingleDLS::memory(runs);
+    }
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef __LABELEXPRESSION_H__
+#define __LABELEXPRESSION_H__
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Boolean label predicate evaluated against the sorted labels set of a pair index
+/// E.g.: (fraud & !cleared) | watchlist is built as
+///     (LabelExpression::label(fraud) & !LabelExpression::label(cleared)) | LabelExpression::label(watchlist)
+/// The tree is stored flat in m_nodes; the last node is the root and children always precede their parents.
+/// An empty (default constructed) expression is not a valid operand: combining it gives an empty expression again,
+/// which matches nothing and is rejected by GraphLabelContainer::registerQuery.
+/// Used by the standing (continuous) label queries of the GraphLabelContainer where each expression is evaluated once
+/// per pair index instead of once per entity.
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+class LabelExpression {
+public:
+    enum Op { LABEL, AND, OR, NOT };
+
+protected:
+    struct Node
+    {
+        Op          op;
+        std::size_t label; //- label index of a LABEL node
+        std::size_t left;  //- operand node positions
+        std::size_t right;
+    };
+    std::vector<Node> m_nodes;
+
+public:
+    //! Returns the expression that is true for the labels sets having the label index
+    static LabelExpression label(std::size_t label_index)
+    {
+        LabelExpression e;
+        e.m_nodes.push_back({LABEL, label_index, 0, 0});
+        return e;
+    }
+
+    //! Returns true if there is no node
+    bool empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    LabelExpression operator&(const LabelExpression &other) const
+    {
+        return combine(AND, other);
+    }
+
+    LabelExpression operator|(const LabelExpression &other) const
+    {
+        return combine(OR, other);
+    }
+
+    LabelExpression operator!() const
+    {
+        if(empty())
+            return LabelExpression();
+        LabelExpression e(*this);
+        std::size_t root = e.m_nodes.size()-1;
+        e.m_nodes.push_back({NOT, 0, root, 0});
+        return e;
+    }
+
+    //! Evaluates the expression for a sorted labels set
+    bool evaluate(const std::vector<std::size_t> &labels) const
+    {
+        if(m_nodes.empty())
+            return false;
+        std::vector<char> values(m_nodes.size());
+        for(std::size_t i = 0; i < m_nodes.size(); ++i)
+        {
+            const Node &n = m_nodes[i];
+            switch(n.op)
+            {
+                case LABEL: values[i] = std::binary_search(labels.begin(), labels.end(), n.label); break;
+                case AND:   values[i] = values[n.left] && values[n.right]; break;
+                case OR:    values[i] = values[n.left] || values[n.right]; break;
+                case NOT:   values[i] = !values[n.left]; break;
+            }
+        }
+        return values.back();
+    }
+
+    //! Returns the sorted label indexes referenced by the expression
+    std::size_t getLabels(std::vector<std::size_t> &labels) const
+    {
+        labels.clear();
+        for(const auto &n : m_nodes)
+        {
+            if(n.op == LABEL)
+                labels.push_back(n.label);
+        }
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        return labels.size();
+    }
+
+    //! Prints the expression
+    void print(std::ostream &out = std::cout) const
+    {
+        if(!m_nodes.empty())
+            print(out, m_nodes.size()-1);
+        out << std::endl;
+    }
+
+protected:
+    //! Returns the binary node over both expressions; empty if an operand is empty
+    LabelExpression combine(Op op, const LabelExpression &other) const
+    {
+        if(empty() || other.empty())
+            return LabelExpression();
+        LabelExpression e(*this);
+        std::size_t left = e.m_nodes.size()-1;
+        std::size_t offset = e.m_nodes.size();
+        for(Node n : other.m_nodes)
+        {
+            if(n.op != LABEL)
+            {
+                n.left += offset;
+                n.right += offset;
+            }
+            e.m_nodes.push_back(n);
+        }
+        e.m_nodes.push_back({op, 0, left, e.m_nodes.size()-1});
+        return e;
+    }
+
+    void print(std::ostream &out, std::size_t i) const
+    {
+        const Node &n = m_nodes[i];
+        switch(n.op)
+        {
+            case LABEL: out << n.label; break;
+            case NOT:   out << "!"; print(out, n.left); break;
+            default:
+                out << "(";
+                print(out, n.left);
+                out << (n.op == AND ? " & " : " | ");
+                print(out, n.right);
+                out << ")";
+        }
+    }
+};
+
+//! Change of a standing label query result; the entity entered or left the result
+struct LabelQueryDelta
+{
+    std::size_t gv;
+    bool        entered;
+};
+
+#endif
@@ -0,0 +1,397 @@
+#ifndef __LABELFILE_H__
+#define __LABELFILE_H__
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Chunked container file: the pair index of each entity is cut into blocks of block_items entities that are encoded,
+/// checksummed (crc32) and written/read independently by a pool of threads with pwrite/pread.
+/// Layout:
+///   magic | dictionary (labels sets, id factory, recycle que) | blocks (in completion order) | block index | trailer
+/// The trailer (fixed size, end of file) locates the dictionary and the block index; the block index holds the
+/// (offset, size, first entity, count, crc, encoding) of each block so that an entity range is read block-wise.
+/// A block is stored as
+///   RAW    : the plain std::size_t pair indexes
+///   PACKED : the pair indexes bit-packed with the width of the largest one
+///   RLE    : bit-packed (pair index, run length) pairs; used when the entities are grouped by pair index (see renumber)
+/// whichever is the smallest, unless compression is off.
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+class LabelFile {
+public:
+    struct Options
+    {
+        std::size_t block_items; //- entities per block
+        std::size_t num_threads; //- 0 --> hardware concurrency
+        bool        compress;    //- PACKED/RLE blocks, RAW otherwise
+
+        Options() : block_items(1 << 16), num_threads(0), compress(true) {}
+    };
+
+    enum Encoding { RAW, PACKED, RLE };
+
+    struct Block
+    {
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint64_t first;    //- first entity
+        std::uint64_t count;    //- number of entities
+        std::uint64_t crc;
+        std::uint64_t encoding;
+    };
+
+protected:
+    enum { MAGIC = 0x31464c4342414c47ULL, TRAILER_WORDS = 8 }; //- "GLABCLF1"
+
+    int                m_fd;
+    std::uint64_t      m_num_items;
+    std::uint64_t      m_block_items;
+    std::string        m_dictionary;
+    std::vector<Block> m_blocks;
+
+public:
+    LabelFile() : m_fd(-1), m_num_items(0), m_block_items(0) {}
+
+    ~LabelFile()
+    {
+        close();
+    }
+
+    //! Opens the file and reads the trailer, the block index and the dictionary; returns false if any is corrupt
+    bool open(const std::string &filename)
+    {
+        close();
+        m_fd = ::open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if(m_fd < 0 || fstat(m_fd, &st) || std::uint64_t(st.st_size) < 8 + TRAILER_WORDS*8)
+            return fail();
+        // dict size, dict crc, num items, block items, num blocks, index offset, index crc, magic
+        std::uint64_t trailer[TRAILER_WORDS];
+        if(!preadAll(m_fd, (char*)trailer, sizeof(trailer), st.st_size - sizeof(trailer)) || trailer[7] != MAGIC)
+            return fail();
+        std::uint64_t index_size = trailer[4]*sizeof(Block);
+        if(trailer[5] + index_size + sizeof(trailer) != std::uint64_t(st.st_size) || 8 + trailer[0] > trailer[5])
+            return fail();
+        m_num_items = trailer[2];
+        m_block_items = trailer[3];
+        m_blocks.resize(trailer[4]);
+        m_dictionary.resize(trailer[0]);
+        if((index_size && !preadAll(m_fd, (char*)m_blocks.data(), index_size, trailer[5])) ||
+           crc32((const char*)m_blocks.data(), index_size) != trailer[6])
+            return fail();
+        if((trailer[0] && !preadAll(m_fd, &m_dictionary[0], trailer[0], 8)) ||
+           crc32(m_dictionary.data(), m_dictionary.size()) != trailer[1])
+            return fail();
+        return true;
+    }
+
+    void close()
+    {
+        if(m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+        m_num_items = m_block_items = 0;
+        m_dictionary.clear();
+        m_blocks.clear();
+    }
+
+    //! Returns the number of entities (the largest entity id)
+    std::size_t size_items() const
+    {
+        return m_num_items;
+    }
+
+    const std::vector<Block> &getBlocks() const
+    {
+        return m_blocks;
+    }
+
+    const std::string &getDictionary() const
+    {
+        return m_dictionary;
+    }
+
+    //! Reads, checks and decodes the blocks overlapping the entities first..last on num_threads threads;
+    //! store(first entity, count, pair indexes) is called concurrently for disjoint blocks. Returns false on a bad block
+    template<class StoreFn>
+    bool readBlocks(std::size_t first, std::size_t last, std::size_t num_threads, StoreFn store) const
+    {
+        if(m_fd < 0)
+            return false;
+        if(first < 1)
+            first = 1;
+        last = std::min<std::size_t>(last, m_num_items);
+        if(first > last || !m_block_items)
+            return true;
+        std::size_t begin = (first-1)/m_block_items, end = std::min<std::size_t>((last-1)/m_block_items + 1, m_blocks.size());
+        std::atomic<bool> ok(true);
+        parallelFor(end - begin, num_threads, [&](std::size_t i)
+        {
+            const Block &block = m_blocks[begin+i];
+            std::string data(block.size, '\0');
+            std::vector<std::size_t> values(block.count);
+            if(!preadAll(m_fd, &data[0], data.size(), block.offset) || crc32(data.data(), data.size()) != block.crc ||
+               !decode(data, values))
+            {
+                ok = false;
+                return;
+            }
+            store(std::size_t(block.first), std::size_t(block.count), values.data());
+        });
+        return ok;
+    }
+
+    //! Writes the file; fill(first entity, count, pair indexes) is called concurrently for disjoint blocks
+    template<class FillFn>
+    static bool write(const std::string &filename, const std::string &dictionary, std::size_t num_items,
+                      const Options &options, FillFn fill)
+    {
+        int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+            return false;
+        std::uint64_t block_items = std::max<std::size_t>(options.block_items, 1);
+        std::vector<Block> blocks((num_items + block_items - 1)/block_items);
+        std::uint64_t magic = MAGIC;
+        bool ok = pwriteAll(fd, (const char*)&magic, 8, 0) && pwriteAll(fd, dictionary.data(), dictionary.size(), 8);
+        std::atomic<std::uint64_t> next(8 + dictionary.size());
+        std::atomic<bool> blocks_ok(true);
+        parallelFor(ok ? blocks.size() : 0, options.num_threads, [&](std::size_t i)
+        {
+            Block &block = blocks[i];
+            block.first = 1 + i*block_items;
+            block.count = std::min<std::uint64_t>(block_items, num_items + 1 - block.first);
+            std::vector<std::size_t> values(block.count);
+            fill(std::size_t(block.first), std::size_t(block.count), values.data());
+            std::string data;
+            block.encoding = encode(values, options.compress, data);
+            block.size = data.size();
+            block.crc = crc32(data.data(), data.size());
+            block.offset = next.fetch_add(data.size());
+            if(!pwriteAll(fd, data.data(), data.size(), block.offset))
+                blocks_ok = false;
+        });
+        std::uint64_t index_offset = next;
+        std::uint64_t trailer[TRAILER_WORDS] = { dictionary.size(), crc32(dictionary.data(), dictionary.size()), num_items,
+            block_items, blocks.size(), index_offset, crc32((const char*)blocks.data(), blocks.size()*sizeof(Block)), MAGIC };
+        ok = ok && blocks_ok && pwriteAll(fd, (const char*)blocks.data(), blocks.size()*sizeof(Block), index_offset) &&
+             pwriteAll(fd, (const char*)trailer, sizeof(trailer), index_offset + blocks.size()*sizeof(Block));
+        return (::close(fd) == 0) && ok;
+    }
+
+    //! Encodes the pair indexes of a block; returns the encoding
+    static Encoding encode(const std::vector<std::size_t> &values, bool compress, std::string &data)
+    {
+        // header: encoding, value width, run length width, number of runs
+        std::uint64_t header[2] = { RAW, values.size() };
+        std::vector<std::uint64_t> words;
+        if(compress)
+        {
+            std::size_t max_value = 0, max_run = 0, runs = 0;
+            for(std::size_t i = 0; i < values.size(); )
+            {
+                std::size_t j = i+1;
+                while(j < values.size() && values[j] == values[i])
+                    ++j;
+                max_value = std::max(max_value, values[i]);
+                max_run = std::max(max_run, j-i);
+                ++runs;
+                i = j;
+            }
+            unsigned width = bits(max_value), run_width = bits(max_run);
+            bool rle = runs*(width + run_width) < values.size()*width;
+            std::size_t bit = 0;
+            words.assign((rle ? runs*(width + run_width) : values.size()*width)/64 + 1, 0);
+            for(std::size_t i = 0; i < values.size(); )
+            {
+                std::size_t j = i+1;
+                if(rle)
+                {
+                    while(j < values.size() && values[j] == values[i])
+                        ++j;
+                    pack(words, bit, j-i, run_width);
+                }
+                pack(words, bit, values[i], width);
+                i = j;
+            }
+            header[0] = (rle ? RLE : PACKED) | (width << 8) | (run_width << 16) | (std::uint64_t(runs) << 24);
+        }
+        data.assign((const char*)header, sizeof(header));
+        if(compress)
+            data.append((const char*)words.data(), words.size()*sizeof(std::uint64_t));
+        else if(!values.empty())
+            data.append((const char*)values.data(), values.size()*sizeof(std::size_t));
+        return Encoding(header[0] & 0xff);
+    }
+
+    //! Decodes a block into values (sized to the number of entities of the block); returns false if it is malformed
+    static bool decode(const std::string &data, std::vector<std::size_t> &values)
+    {
+        std::uint64_t header[2];
+        if(data.size() < sizeof(header))
+            return false;
+        std::memcpy(header, data.data(), sizeof(header));
+        if(header[1] != values.size())
+            return false;
+        std::size_t payload = data.size() - sizeof(header);
+        unsigned encoding = header[0] & 0xff, width = (header[0] >> 8) & 0xff, run_width = (header[0] >> 16) & 0xff;
+        std::size_t runs = header[0] >> 24;
+        if(encoding == RAW)
+        {
+            if(payload != values.size()*sizeof(std::size_t))
+                return false;
+            if(payload)
+                std::memcpy(values.data(), data.data() + sizeof(header), payload);
+            return true;
+        }
+        std::size_t nbits = (encoding == RLE) ? runs*(width + run_width) : values.size()*width;
+        if(width > 64 || run_width > 64 || payload != (nbits/64 + 1)*sizeof(std::uint64_t))
+            return false;
+        std::vector<std::uint64_t> words(payload/sizeof(std::uint64_t));
+        std::memcpy(words.data(), data.data() + sizeof(header), payload);
+        std::size_t bit = 0;
+        if(encoding == PACKED)
+        {
+            for(auto &value : values)
+                value = unpack(words, bit, width);
+            return true;
+        }
+        std::size_t n = 0;
+        for(std::size_t r = 0; r < runs; ++r)
+        {
+            std::size_t run = unpack(words, bit, run_width);
+            std::size_t value = unpack(words, bit, width);
+            if(run > values.size() - n)
+                return false;
+            std::fill(values.begin() + n, values.begin() + n + run, value);
+            n += run;
+        }
+        return n == values.size();
+    }
+
+    //! crc32 (IEEE 802.3)
+    static std::uint32_t crc32(const char *data, std::size_t size, std::uint32_t crc = 0)
+    {
+        static const std::vector<std::uint32_t> table = crcTable();
+        crc = ~crc;
+        for(std::size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    //! Calls fn(i) for i in [0, n) on num_threads threads (0 --> hardware concurrency)
+    template<class Fn>
+    static void parallelFor(std::size_t n, std::size_t num_threads, Fn fn)
+    {
+        if(!num_threads)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        num_threads = std::min(num_threads, n);
+        if(num_threads <= 1)
+        {
+            for(std::size_t i = 0; i < n; ++i)
+                fn(i);
+            return;
+        }
+        std::atomic<std::size_t> next(0);
+        std::vector<std::thread> threads;
+        for(std::size_t t = 0; t < num_threads; ++t)
+        {
+            threads.emplace_back([&]
+            {
+                for(std::size_t i = next++; i < n; i = next++)
+                    fn(i);
+            });
+        }
+        for(auto &thread : threads)
+            thread.join();
+    }
+
+protected:
+    bool fail()
+    {
+        close();
+        return false;
+    }
+
+    static unsigned bits(std::size_t value)
+    {
+        unsigned n = 0;
+        for(; value; value >>= 1)
+            ++n;
+        return n;
+    }
+
+    static void pack(std::vector<std::uint64_t> &words, std::size_t &bit, std::uint64_t value, unsigned width)
+    {
+        if(!width)
+            return;
+        std::size_t w = bit/64, o = bit%64;
+        words[w] |= value << o;
+        if(o + width > 64)
+            words[w+1] |= value >> (64 - o);
+        bit += width;
+    }
+
+    static std::uint64_t unpack(const std::vector<std::uint64_t> &words, std::size_t &bit, unsigned width)
+    {
+        if(!width)
+            return 0;
+        std::size_t w = bit/64, o = bit%64;
+        std::uint64_t value = words[w] >> o;
+        if(o + width > 64)
+            value |= words[w+1] << (64 - o);
+        bit += width;
+        return (width == 64) ? value : (value & ((std::uint64_t(1) << width) - 1));
+    }
+
+    static std::vector<std::uint32_t> crcTable()
+    {
+        std::vector<std::uint32_t> table(256);
+        for(std::uint32_t i = 0; i < 256; ++i)
+        {
+            std::uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }
+
+    static bool preadAll(int fd, char *data, std::size_t size, std::uint64_t offset)
+    {
+        while(size)
+        {
+            ssize_t n = ::pread(fd, data, size, offset);
+            if(n <= 0)
+                return false;
+            data += n;
+            size -= n;
+            offset += n;
+        }
+        return true;
+    }
+
+    static bool pwriteAll(int fd, const char *data, std::size_t size, std::uint64_t offset)
+    {
+        while(size)
+        {
+            ssize_t n = ::pwrite(fd, data, size, offset);
+            if(n <= 0)
+                return false;
+            data += n;
+            size -= n;
+            offset += n;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,512 @@
+#ifndef __LABELINGEST_H__
+#define __LABELINGEST_H__
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include "GraphLabelContainer.h"
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Fixed capacity FIFO between two threads; push blocks when full and pop blocks when empty until close is called.
+/// abort drops the items and releases both sides for good
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+template<typename T>
+class BoundedQueue {
+protected:
+    std::deque<T>           m_items;
+    std::size_t             m_capacity;
+    bool                    m_closed;
+    bool                    m_aborted;
+    std::mutex              m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+
+public:
+    BoundedQueue(std::size_t capacity) : m_capacity(std::max<std::size_t>(capacity, 1)), m_closed(false), m_aborted(false) {}
+
+    //! Returns false if the queue is aborted; the item is dropped
+    bool push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this] { return m_items.size() < m_capacity || m_aborted; });
+        if(m_aborted)
+            return false;
+        m_items.push_back(std::move(item));
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    //! Returns false when the queue is closed and drained, or aborted
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+        if(m_items.empty() || m_aborted)
+            return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    //! No more pushes; wakes up the consumer
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_not_empty.notify_all();
+    }
+
+    //! Drops the items and makes push and pop return false from now on
+    void abort()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_items.clear();
+        m_closed = true;
+        m_aborted = true;
+        m_not_empty.notify_all();
+        m_not_full.notify_all();
+    }
+};
+
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Pipelined loader of (entity name, label string) rows of delimited tables into a GraphLabelContainer
+/// E.g.: vertexes(id,label) with entity_column 0, label_column 1 or edges(id,source_name,target_name,label) with
+/// entity_column 0, label_column 3.
+///
+/// The stages run on their own threads connected by bounded queues of queue_depth batches:
+///   reader : reads the input in chunk_size blocks cut at the last line end
+///   parser : splits the block into rows and locates the entity/label fields (offsets into the block, no copies)
+///   intern : dictionary encodes the entity names to graph entity ids and the label strings to label indexes (from 1)
+///   group  : sorts the (label, entity) pairs of the batch and removes the duplicates
+/// and the calling thread applies each label group with the batch addLabel of the container, which is the only stage
+/// touching the container. The memory in flight is bounded by ~4 x queue_depth x chunk_size regardless of the input
+/// size; only the dictionaries grow, with the number of distinct names.
+///
+/// Fields may be quoted ("a,b" with "" for a quote); a quoted field may not span lines. Rows with an unterminated
+/// quote or a quote inside an unquoted field are counted as skipped. If a stage or the container throws, the queues
+/// are aborted, all the stage threads are joined and load rethrows the first exception.
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+class LabelIngest {
+public:
+    struct Options
+    {
+        char        delimiter;
+        std::size_t entity_column;
+        std::size_t label_column;
+        bool        header;      //- skip the first line
+        std::size_t chunk_size;  //- bytes read at once
+        std::size_t queue_depth; //- batches in flight between two stages
+
+        Options() : delimiter(','), entity_column(0), label_column(1), header(false), chunk_size(1 << 20), queue_depth(4) {}
+    };
+
+    struct Stats
+    {
+        std::size_t rows;    //- (entity, label) rows applied
+        std::size_t skipped; //- rows with missing fields or malformed quotes
+        std::size_t batches;
+        double      seconds;
+
+        Stats() : rows(0), skipped(0), batches(0), seconds(0) {}
+
+        double rowsPerSecond() const
+        {
+            return seconds > 0 ? rows / seconds : 0;
+        }
+
+        void print(std::ostream &out = std::cout) const
+        {
+            out << "rows: " << rows << " skipped: " << skipped << " batches: " << batches
+                << " in " << seconds << " s (" << std::size_t(rowsPerSecond()) << " rows/sec)" << std::endl;
+        }
+    };
+
+protected:
+    struct Rows
+    {
+        std::string              text;   //- the block of complete lines
+        std::vector<std::size_t> fields; //- (entity offset, length, label offset, length) per row
+        std::size_t              skipped;
+    };
+
+    struct Groups
+    {
+        std::vector<std::size_t> labels;  //- distinct labels of the batch
+        std::vector<std::size_t> offsets; //- labels[i] --> entities[offsets[i], offsets[i+1])
+        std::vector<std::size_t> entities;
+        std::size_t              rows;
+        std::size_t              skipped;
+    };
+
+    GraphLabelContainer                          &m_glc;
+    Options                                      m_options;
+    Stats                                        m_stats;
+    std::unordered_map<std::string, std::size_t> m_entity2index;
+    std::unordered_map<std::string, std::size_t> m_label2index;
+    std::vector<std::string>                     m_index2entity; //- [0] unused
+    std::vector<std::string>                     m_index2label;  //- [0] unused
+
+public:
+    LabelIngest(GraphLabelContainer &glc, const Options &options = Options())
+    : m_glc(glc), m_options(options), m_index2entity(1), m_index2label(1) {}
+
+    //! Returns the entity id of the name; a new id is assigned to an unknown name
+    std::size_t entity(const std::string &name)
+    {
+        return intern(name, m_entity2index, m_index2entity);
+    }
+
+    //! Returns the label index of the label string; a new index is assigned to an unknown string
+    std::size_t label(const std::string &name)
+    {
+        return intern(name, m_label2index, m_index2label);
+    }
+
+    //! Returns the entity names indexed by the entity ids; index 0 is unused
+    const std::vector<std::string> &getEntityNames() const
+    {
+        return m_index2entity;
+    }
+
+    //! Returns the label strings indexed by the label indexes; index 0 is unused
+    const std::vector<std::string> &getLabelNames() const
+    {
+        return m_index2label;
+    }
+
+    //! Returns the statistics of the last load
+    const Stats &getStats() const
+    {
+        return m_stats;
+    }
+
+    //! Loads the rows of the file; returns the number of rows applied
+    std::size_t load(const std::string &filename)
+    {
+        std::ifstream in(filename.c_str(), std::ios::binary);
+        if(!in)
+        {
+            m_stats = Stats();
+            return 0;
+        }
+        return load(in);
+    }
+
+    //! Loads the rows of the stream; returns the number of rows applied
+    std::size_t load(std::istream &in)
+    {
+        m_stats = Stats();
+        auto start = std::chrono::steady_clock::now();
+        BoundedQueue<std::string> blocks(m_options.queue_depth);
+        BoundedQueue<Rows> rows(m_options.queue_depth);
+        BoundedQueue<std::vector<std::size_t>> pairs(m_options.queue_depth);
+        BoundedQueue<Groups> groups(m_options.queue_depth);
+
+        Stages stages;
+        stages.abort = [&] { blocks.abort(); rows.abort(); pairs.abort(); groups.abort(); };
+        stages.run([&] { read(in, blocks); }, [&] { blocks.close(); });
+        stages.run([&] { parse(blocks, rows); }, [&] { rows.close(); });
+        stages.run([&] { encode(rows, pairs); }, [&] { pairs.close(); });
+        stages.run([&] { group(pairs, groups); }, [&] { groups.close(); });
+
+        try
+        {
+            Groups batch;
+            std::vector<std::size_t> gvs;
+            while(groups.pop(batch))
+            {
+                for(std::size_t i = 0; i < batch.labels.size(); ++i)
+                {
+                    gvs.assign(batch.entities.begin() + batch.offsets[i], batch.entities.begin() + batch.offsets[i+1]);
+                    m_glc.addLabel(gvs, batch.labels[i]);
+                }
+                m_stats.rows += batch.rows;
+                m_stats.skipped += batch.skipped;
+                ++m_stats.batches;
+            }
+        }
+        catch(...)
+        {
+            stages.fail();
+        }
+        stages.join();
+        m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(stages.error)
+            std::rethrow_exception(stages.error);
+        return m_stats.rows;
+    }
+
+protected:
+    //! The stage threads of a load; they are joined on every exit path. The first exception of a stage (or of the
+    //! caller, see fail) is kept and aborts the queues so that no stage stays blocked
+    struct Stages
+    {
+        std::vector<std::thread> threads;
+        std::function<void()>    abort;
+        std::exception_ptr       error;
+        std::mutex               mutex;
+
+        ~Stages()
+        {
+            if(!threads.empty())
+            {
+                fail(std::exception_ptr());
+                join();
+            }
+        }
+
+        //! Runs the stage on its own thread; close is called when it returns or throws
+        void run(std::function<void()> stage, std::function<void()> close)
+        {
+            threads.emplace_back([this, stage, close]
+            {
+                try
+                {
+                    stage();
+                }
+                catch(...)
+                {
+                    fail();
+                }
+                close();
+            });
+        }
+
+        void fail(std::exception_ptr e = std::current_exception())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(!error)
+                    error = e;
+            }
+            if(abort)
+                abort();
+        }
+
+        void join()
+        {
+            for(auto &thread : threads)
+            {
+                if(thread.joinable())
+                    thread.join();
+            }
+            threads.clear();
+        }
+    };
+
+    static std::size_t intern(const std::string &name, std::unordered_map<std::string, std::size_t> &name2index,
+                              std::vector<std::string> &index2name)
+    {
+        auto it = name2index.insert(std::make_pair(name, index2name.size()));
+        if(it.second)
+            index2name.push_back(name);
+        return it.first->second;
+    }
+
+    //! Reader stage: blocks of complete lines
+    void read(std::istream &in, BoundedQueue<std::string> &blocks)
+    {
+        std::string carry;
+        bool header = m_options.header;
+        std::size_t chunk_size = std::max<std::size_t>(m_options.chunk_size, 64);
+        while(in)
+        {
+            std::string block;
+            block.reserve(carry.size() + chunk_size);
+            block.swap(carry);
+            std::size_t size = block.size();
+            block.resize(size + chunk_size);
+            in.read(&block[size], chunk_size);
+            block.resize(size + in.gcount());
+            std::size_t end = block.rfind('\n');
+            if(in && end == std::string::npos)
+            {
+                // a line longer than the chunk
+                carry.swap(block);
+                continue;
+            }
+            if(in)
+            {
+                carry.assign(block, end+1, std::string::npos);
+                block.resize(end+1);
+            }
+            if(header)
+            {
+                std::size_t first = block.find('\n');
+                block.erase(0, first == std::string::npos ? block.size() : first+1);
+                header = false;
+            }
+            if(!block.empty() && !blocks.push(std::move(block)))
+                return;
+        }
+    }
+
+    //! Parser stage: field offsets of the rows
+    void parse(BoundedQueue<std::string> &blocks, BoundedQueue<Rows> &rows)
+    {
+        const char delimiter = m_options.delimiter;
+        const std::size_t entity_column = m_options.entity_column, label_column = m_options.label_column;
+        const std::size_t last_column = std::max(entity_column, label_column);
+        std::string block;
+        while(blocks.pop(block))
+        {
+            Rows batch;
+            batch.skipped = 0;
+            batch.text.swap(block);
+            const std::string &text = batch.text;
+            std::size_t pos = 0;
+            while(pos < text.size())
+            {
+                std::size_t eol = text.find('\n', pos);
+                if(eol == std::string::npos)
+                    eol = text.size();
+                std::size_t end = (eol > pos && text[eol-1] == '\r') ? eol-1 : eol;
+                if(end > pos)
+                {
+                    std::size_t fields[4] = {0, 0, 0, 0};
+                    std::size_t column = 0;
+                    bool malformed = false;
+                    for(std::size_t i = pos; column <= last_column; ++i)
+                    {
+                        std::size_t begin = i, j = i;
+                        if(i < end && text[i] == '"')
+                        {
+                            // up to the closing quote; "" is an escaped quote
+                            for(j = i+1; j < end; ++j)
+                            {
+                                if(text[j] != '"')
+                                    continue;
+                                if(j+1 < end && text[j+1] == '"')
+                                    ++j;
+                                else
+                                    break;
+                            }
+                            malformed = (j >= end || (j+1 < end && text[j+1] != delimiter));
+                            begin = i+1;
+                            i = j+1;
+                        }
+                        else
+                        {
+                            for(; j < end && text[j] != delimiter; ++j)
+                            {
+                                if(text[j] == '"')
+                                    malformed = true;
+                            }
+                            i = j;
+                        }
+                        if(malformed)
+                            break;
+                        if(column == entity_column)
+                        {
+                            fields[0] = begin;
+                            fields[1] = j - begin;
+                        }
+                        if(column == label_column)
+                        {
+                            fields[2] = begin;
+                            fields[3] = j - begin;
+                        }
+                        ++column;
+                        if(i >= end)
+                            break;
+                    }
+                    if(!malformed && column > last_column && fields[1] && fields[3])
+                        batch.fields.insert(batch.fields.end(), fields, fields+4);
+                    else
+                        ++batch.skipped;
+                }
+                pos = eol+1;
+            }
+            if(!rows.push(std::move(batch)))
+                return;
+        }
+    }
+
+    //! Intern stage: (label, entity) pairs followed by the row and skipped counts
+    void encode(BoundedQueue<Rows> &rows, BoundedQueue<std::vector<std::size_t>> &pairs)
+    {
+        Rows batch;
+        std::string name;
+        while(rows.pop(batch))
+        {
+            std::vector<std::size_t> encoded;
+            encoded.reserve(batch.fields.size()/2 + 2);
+            for(std::size_t i = 0; i < batch.fields.size(); i += 4)
+            {
+                unquote(batch.text, batch.fields[i+2], batch.fields[i+3], name);
+                encoded.push_back(label(name));
+                unquote(batch.text, batch.fields[i], batch.fields[i+1], name);
+                encoded.push_back(entity(name));
+            }
+            encoded.push_back(batch.fields.size()/4);
+            encoded.push_back(batch.skipped);
+            if(!pairs.push(std::move(encoded)))
+                return;
+        }
+    }
+
+    //! Copies the field; the quotes left in it are the escaped ("") quotes of a quoted field
+    static void unquote(const std::string &text, std::size_t offset, std::size_t length, std::string &name)
+    {
+        name.assign(text, offset, length);
+        if(name.find('"') == std::string::npos)
+            return;
+        std::size_t n = 0;
+        for(std::size_t i = 0; i < name.size(); ++i, ++n)
+        {
+            name[n] = name[i];
+            if(name[i] == '"' && i+1 < name.size() && name[i+1] == '"')
+                ++i;
+        }
+        name.resize(n);
+    }
+
+    //! Group stage: distinct entities of each label
+    void group(BoundedQueue<std::vector<std::size_t>> &pairs, BoundedQueue<Groups> &groups)
+    {
+        std::vector<std::size_t> encoded;
+        std::vector<std::pair<std::size_t, std::size_t>> sorted;
+        while(pairs.pop(encoded))
+        {
+            Groups batch;
+            batch.skipped = encoded.back();
+            encoded.pop_back();
+            batch.rows = encoded.back();
+            encoded.pop_back();
+            sorted.resize(encoded.size()/2);
+            for(std::size_t i = 0; i < sorted.size(); ++i)
+                sorted[i] = std::make_pair(encoded[2*i], encoded[2*i+1]);
+            std::sort(sorted.begin(), sorted.end());
+            sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+            batch.entities.reserve(sorted.size());
+            for(std::size_t i = 0; i < sorted.size(); ++i)
+            {
+                if(!i || sorted[i].first != sorted[i-1].first)
+                {
+                    batch.labels.push_back(sorted[i].first);
+                    batch.offsets.push_back(i);
+                }
+                batch.entities.push_back(sorted[i].second);
+            }
+            batch.offsets.push_back(sorted.size());
+            if(!groups.push(std::move(batch)))
+                return;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,346 @@
+#ifndef __LABELPATHINDEX_H__
+#define __LABELPATHINDEX_H__
+
+#include <vector>
+#include <map>
+#include <array>
+#include <algorithm>
+#include "GraphLabelContainer.h"
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Label schema graph of a property graph whose node and edge labels are kept in two GraphLabelContainers
+/// Each directed edge (src entity, edge entity, dst entity) is counted under the triple of pair indexes
+/// (src labels set, edge labels set, dst labels set); the number of distinct triples is tiny compared to the edges.
+/// The index listens to the entity moves of both containers (see GraphLabelContainer::addMoveListener): the edges of
+/// a moved entity are recounted under their current triple, which is kept per edge so that a move is undone exactly.
+/// Label patterns are then checked over the triples before any traversal:
+///   prunePath      : per hop allowed node/edge pair indexes of a src -e1-> ... -ek-> dst label path
+///   isReachableWithin : whether a node with the dst label can be reached from a node with the src label in k hops
+/// A label matches a pair index through GraphLabelContainer::getSubsumedIndexes, i.e., with its is-a descendants;
+/// label 0 matches any pair index including the unlabeled entities (pair index 0). A posting label (see
+/// GraphLabelContainer::setPostingLabel) is not part of the pair indexes and conservatively matches any of them too.
+/// clear/read/readFile of the containers are not notified; call rebuild afterwards. Renumbered entities are
+/// followed with applyNodeRenumbering/applyEdgeRenumbering.
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+class LabelPathIndex {
+protected:
+    typedef std::array<std::size_t, 3> Triple; //- (src pair index, edge pair index, dst pair index)
+
+    GraphLabelContainer                   &m_nodes;
+    GraphLabelContainer                   &m_edges;
+    std::size_t                           m_node_listener;
+    std::size_t                           m_edge_listener;
+    std::vector<std::size_t>              m_ends;     //- edge --> (src, dst) entities; (0, 0) if not an edge
+    std::vector<std::size_t>              m_counted;  //- edge --> triple it is counted under
+    std::vector<std::vector<std::size_t>> m_incident; //- node --> edges having it as src or dst (a loop once)
+    std::map<Triple, std::size_t>         m_triples;  //- triple --> number of edges
+
+public:
+    LabelPathIndex(GraphLabelContainer &nodes, GraphLabelContainer &edges) : m_nodes(nodes), m_edges(edges)
+    {
+        m_node_listener = m_nodes.addMoveListener([this](const std::size_t *gvs, std::size_t n, std::size_t, std::size_t)
+        {
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                if(gvs[i] < m_incident.size())
+                {
+                    for(auto edge : m_incident[gvs[i]])
+                        recount(edge);
+                }
+            }
+        });
+        m_edge_listener = m_edges.addMoveListener([this](const std::size_t *gvs, std::size_t n, std::size_t, std::size_t)
+        {
+            for(std::size_t i = 0; i < n; ++i)
+                recount(gvs[i]);
+        });
+    }
+
+    ~LabelPathIndex()
+    {
+        m_nodes.removeMoveListener(m_node_listener);
+        m_edges.removeMoveListener(m_edge_listener);
+    }
+
+    LabelPathIndex(const LabelPathIndex&) = delete;
+    LabelPathIndex &operator=(const LabelPathIndex&) = delete;
+
+    //! Adds the directed edge src --> dst; returns false if the edge exists or an id is 0
+    bool addEdge(std::size_t edge, std::size_t src, std::size_t dst)
+    {
+        if(!edge || !src || !dst || hasEdge(edge))
+            return false;
+        if(2*edge+1 >= m_ends.size())
+        {
+            m_ends.resize(2*edge+2, 0);
+            m_counted.resize(3*edge+3, 0);
+        }
+        if(std::max(src, dst) >= m_incident.size())
+            m_incident.resize(std::max(src, dst)+1);
+        m_ends[2*edge] = src;
+        m_ends[2*edge+1] = dst;
+        m_incident[src].push_back(edge);
+        if(dst != src)
+            m_incident[dst].push_back(edge);
+        Triple triple = current(edge);
+        std::copy(triple.begin(), triple.end(), m_counted.begin() + 3*edge);
+        m_triples[triple]++;
+        return true;
+    }
+
+    //! Removes the edge; returns false if it does not exist
+    bool removeEdge(std::size_t edge)
+    {
+        if(!hasEdge(edge))
+            return false;
+        uncount(edge);
+        for(std::size_t end = 0; end < 2; ++end)
+        {
+            std::vector<std::size_t> &edges = m_incident[m_ends[2*edge+end]];
+            auto it = std::find(edges.begin(), edges.end(), edge);
+            if(it != edges.end())
+                edges.erase(it);
+        }
+        m_ends[2*edge] = m_ends[2*edge+1] = 0;
+        return true;
+    }
+
+    bool hasEdge(std::size_t edge) const
+    {
+        return 2*edge < m_ends.size() && m_ends[2*edge];
+    }
+
+    //! Returns the number of edges counted under the triple of pair indexes
+    std::size_t getTripleCount(std::size_t src_index, std::size_t edge_index, std::size_t dst_index) const
+    {
+        auto it = m_triples.find(Triple{{src_index, edge_index, dst_index}});
+        return (it == m_triples.end()) ? 0 : it->second;
+    }
+
+    //! Returns the (src index, edge index, dst index, number of edges) quadruplets sorted by triple
+    std::size_t getTriples(std::vector<std::size_t> &triples) const
+    {
+        triples.clear();
+        for(auto &it : m_triples)
+        {
+            triples.insert(triples.end(), it.first.begin(), it.first.end());
+            triples.push_back(it.second);
+        }
+        return m_triples.size();
+    }
+
+    //! Returns the number of distinct triples, i.e., the size of the schema graph
+    std::size_t size() const
+    {
+        return m_triples.size();
+    }
+
+    //! Recounts all the edges from the containers
+    void rebuild()
+    {
+        m_triples.clear();
+        for(std::size_t edge = 1; edge < m_ends.size()/2; ++edge)
+        {
+            if(!hasEdge(edge))
+                continue;
+            Triple triple = current(edge);
+            std::copy(triple.begin(), triple.end(), m_counted.begin() + 3*edge);
+            m_triples[triple]++;
+        }
+    }
+
+    //! Checks the path src_label -edge_labels[0]-> ... -edge_labels[k-1]-> dst_label over the triples. On return,
+    //! node_indexes[i] (i = 0..k) are the pair indexes a node at position i of a matching path can have and
+    //! edge_indexes[i] the ones of the ith edge, pruned both ways. Returns false if no path can match
+    bool prunePath(std::size_t src_label, const std::vector<std::size_t> &edge_labels, std::size_t dst_label,
+                   std::vector<std::vector<std::size_t>> &node_indexes, std::vector<std::vector<std::size_t>> &edge_indexes) const
+    {
+        std::size_t num_hops = edge_labels.size();
+        node_indexes.assign(num_hops+1, std::vector<std::size_t>());
+        edge_indexes.assign(num_hops, std::vector<std::size_t>());
+        // forward: the pair indexes reachable from the src label
+        for(auto &it : m_triples)
+        {
+            if(it.second && matches(m_nodes, src_label, it.first[0]))
+                node_indexes[0].push_back(it.first[0]);
+        }
+        unique(node_indexes[0]);
+        for(std::size_t hop = 0; hop < num_hops; ++hop)
+        {
+            for(auto &it : m_triples)
+            {
+                const Triple &t = it.first;
+                if(it.second && std::binary_search(node_indexes[hop].begin(), node_indexes[hop].end(), t[0]) &&
+                   matches(m_edges, edge_labels[hop], t[1]))
+                    node_indexes[hop+1].push_back(t[2]);
+            }
+            unique(node_indexes[hop+1]);
+        }
+        std::vector<std::size_t> &last = node_indexes[num_hops];
+        last.erase(std::remove_if(last.begin(), last.end(),
+                   [&](std::size_t index) { return !matches(m_nodes, dst_label, index); }), last.end());
+        // backward: keep the hops that lead to the dst label
+        for(std::size_t hop = num_hops; hop-- > 0; )
+        {
+            std::vector<std::size_t> sources;
+            for(auto &it : m_triples)
+            {
+                const Triple &t = it.first;
+                if(it.second && std::binary_search(node_indexes[hop].begin(), node_indexes[hop].end(), t[0]) &&
+                   std::binary_search(node_indexes[hop+1].begin(), node_indexes[hop+1].end(), t[2]) &&
+                   matches(m_edges, edge_labels[hop], t[1]))
+                {
+                    sources.push_back(t[0]);
+                    edge_indexes[hop].push_back(t[1]);
+                }
+            }
+            unique(sources);
+            unique(edge_indexes[hop]);
+            node_indexes[hop].swap(sources);
+        }
+        return !node_indexes[0].empty() && !last.empty();
+    }
+
+    //! Returns true if a path src_label -edge_labels[0]-> ... -edge_labels[k-1]-> dst_label may exist
+    bool isReachable(std::size_t src_label, const std::vector<std::size_t> &edge_labels, std::size_t dst_label) const
+    {
+        std::vector<std::vector<std::size_t>> node_indexes, edge_indexes;
+        return prunePath(src_label, edge_labels, dst_label, node_indexes, edge_indexes);
+    }
+
+    //! Returns true if a node with the dst label may be reached from a node with the src label in 1..max_hops hops
+    //! along edges with edge_label (0: any); the smallest number of hops is returned in hops
+    bool isReachableWithin(std::size_t src_label, std::size_t dst_label, std::size_t max_hops, std::size_t edge_label = 0,
+                           std::size_t *hops = nullptr) const
+    {
+        std::vector<std::size_t> frontier, visited, next;
+        for(auto &it : m_triples)
+        {
+            if(it.second && matches(m_nodes, src_label, it.first[0]))
+                frontier.push_back(it.first[0]);
+        }
+        unique(frontier);
+        visited = frontier;
+        for(std::size_t hop = 1; hop <= max_hops && !frontier.empty(); ++hop)
+        {
+            next.clear();
+            for(auto &it : m_triples)
+            {
+                const Triple &t = it.first;
+                if(it.second && std::binary_search(frontier.begin(), frontier.end(), t[0]) && matches(m_edges, edge_label, t[1]))
+                    next.push_back(t[2]);
+            }
+            unique(next);
+            for(auto index : next)
+            {
+                if(matches(m_nodes, dst_label, index))
+                {
+                    if(hops)
+                        *hops = hop;
+                    return true;
+                }
+            }
+            SortedSets::subtract(next, visited, frontier);
+            std::vector<std::size_t> merged;
+            SortedSets::unite(visited, frontier, merged);
+            visited.swap(merged);
+        }
+        return false;
+    }
+
+    //! Follows a renumbering of the node entities; perm[old node] = new node
+    void applyNodeRenumbering(const std::vector<std::size_t> &perm)
+    {
+        std::vector<std::vector<std::size_t>> incident(m_incident.size());
+        for(std::size_t node = 1; node < m_incident.size() && node < perm.size(); ++node)
+        {
+            if(perm[node] >= incident.size())
+                incident.resize(perm[node]+1);
+            incident[perm[node]].swap(m_incident[node]);
+        }
+        m_incident.swap(incident);
+        for(std::size_t i = 2; i < m_ends.size(); ++i)
+        {
+            if(m_ends[i] && m_ends[i] < perm.size())
+                m_ends[i] = perm[m_ends[i]];
+        }
+    }
+
+    //! Follows a renumbering of the edge entities; perm[old edge] = new edge
+    void applyEdgeRenumbering(const std::vector<std::size_t> &perm)
+    {
+        std::size_t num_edges = m_ends.size()/2;
+        for(std::size_t edge = 1; edge < num_edges && edge < perm.size(); ++edge)
+            num_edges = std::max(num_edges, perm[edge]+1);
+        std::vector<std::size_t> ends(2*num_edges, 0), counted(3*num_edges, 0);
+        for(std::size_t edge = 1; edge < m_ends.size()/2; ++edge)
+        {
+            std::size_t to = (edge < perm.size()) ? perm[edge] : edge;
+            std::copy(m_ends.begin() + 2*edge, m_ends.begin() + 2*edge+2, ends.begin() + 2*to);
+            std::copy(m_counted.begin() + 3*edge, m_counted.begin() + 3*edge+3, counted.begin() + 3*to);
+        }
+        m_ends.swap(ends);
+        m_counted.swap(counted);
+        for(auto &edges : m_incident)
+        {
+            for(auto &edge : edges)
+            {
+                if(edge < perm.size())
+                    edge = perm[edge];
+            }
+        }
+    }
+
+    //! Returns the memory occupied
+    std::size_t memory() const
+    {
+        return SingleDLS::memory(m_ends) + SingleDLS::memory(m_counted) + SingleDLS::memory(m_incident) +
+               m_triples.size()*(sizeof(Triple) + sizeof(std::size_t) + 4*sizeof(void*));
+    }
+
+protected:
+    //! Returns the triple of the edge from the containers
+    Triple current(std::size_t edge) const
+    {
+        return Triple{{m_nodes.getPairIndex(m_ends[2*edge]), m_edges.getPairIndex(edge), m_nodes.getPairIndex(m_ends[2*edge+1])}};
+    }
+
+    void uncount(std::size_t edge)
+    {
+        Triple triple{{m_counted[3*edge], m_counted[3*edge+1], m_counted[3*edge+2]}};
+        auto it = m_triples.find(triple);
+        if(it != m_triples.end() && !--it->second)
+            m_triples.erase(it);
+    }
+
+    //! Moves the edge to its current triple
+    void recount(std::size_t edge)
+    {
+        if(!hasEdge(edge))
+            return;
+        Triple triple = current(edge);
+        if(std::equal(triple.begin(), triple.end(), m_counted.begin() + 3*edge))
+            return;
+        uncount(edge);
+        std::copy(triple.begin(), triple.end(), m_counted.begin() + 3*edge);
+        m_triples[triple]++;
+    }
+
+    //! Returns true if the labels set of the pair index has the label or one of its descendants (0 or posting: any)
+    static bool matches(const GraphLabelContainer &glc, std::size_t label, std::size_t pair_index)
+    {
+        if(!label || glc.isPosting(label))
+            return true;
+        const std::vector<std::size_t> &indexes = glc.getSubsumedIndexes(label);
+        return pair_index && std::binary_search(indexes.begin(), indexes.end(), pair_index);
+    }
+
+    static void unique(std::vector<std::size_t> &ids)
+    {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+};
+
+#endif
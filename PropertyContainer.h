@@ -0,0 +1,348 @@
+#ifndef __PROPERTYCONTAINER_H__
+#define __PROPERTYCONTAINER_H__
+
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+#include "GraphLabelContainer.h"
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Low cardinality key --> value properties of graph entities (status, region, risk bucket, ...) stored with the
+/// tuple sharing of the GraphLabelContainer: each distinct (key, value) is interned as a label index and the
+/// property set of an entity is the labels set of its pair index, so an entity costs one chain slot however many
+/// properties it has; an entity has at most one value per key.
+/// E.g.: {status=open, region=EU, risk_score=12} is one pair index shared by all the entities with these values.
+///
+/// Each key has a typed value dictionary: NUMBER keys keep the values (doubles; integers are exact up to 2^53) in
+/// an ordered map so that range predicates like risk_score <= 15 resolve to the labels of the qualifying values
+/// with a map range, then to the pair indexes of those labels; entities are visited only for the final result.
+/// STRING keys support equality/inequality predicates only; an ordering predicate on a STRING key is rejected.
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+class PropertyContainer {
+public:
+    enum Type { NUMBER, STRING };
+    enum Op { EQ, NE, LT, LE, GT, GE };
+
+    //! key op value; the value is number for NUMBER keys and text for STRING keys
+    struct Predicate
+    {
+        std::size_t key;
+        Op          op;
+        double      number;
+        std::string text;
+
+        Predicate(std::size_t k, Op o, double value) : key(k), op(o), number(value) {}
+        Predicate(std::size_t k, Op o, const std::string &value) : key(k), op(o), number(0), text(value) {}
+    };
+
+protected:
+    struct Key
+    {
+        std::string                        name;
+        Type                               type;
+        std::map<double, std::size_t>      numbers; //- value --> label index
+        std::map<std::string, std::size_t> strings; //- value --> label index
+    };
+
+    GraphLabelContainer      m_glc;
+    std::vector<Key>         m_keys;         //- [0] unused
+    std::map<std::string, std::size_t> m_name2key;
+    std::vector<std::size_t> m_label2key;    //- key of each label index
+    std::vector<double>      m_label2number; //- value of each NUMBER label index
+    std::vector<std::string> m_label2string; //- value of each STRING label index
+
+public:
+    PropertyContainer() : m_keys(1), m_label2key(1), m_label2number(1), m_label2string(1) {}
+
+    //! Returns the id of the key, adding it if new; returns 0 if it exists with another type
+    std::size_t addKey(const std::string &name, Type type)
+    {
+        auto it = m_name2key.find(name);
+        if(it != m_name2key.end())
+            return (m_keys[it->second].type == type) ? it->second : 0;
+        m_keys.push_back(Key());
+        m_keys.back().name = name;
+        m_keys.back().type = type;
+        m_name2key[name] = m_keys.size()-1;
+        return m_keys.size()-1;
+    }
+
+    //! Returns the id of the key, 0 if unknown
+    std::size_t getKey(const std::string &name) const
+    {
+        auto it = m_name2key.find(name);
+        return (it == m_name2key.end()) ? 0 : it->second;
+    }
+
+    //! Sets the value of a NUMBER key of the entity; returns false if the key is not a NUMBER key or the value is NaN
+    //! (it has no place in the ordered value dictionary)
+    bool setNumber(std::size_t gv, std::size_t key, double value)
+    {
+        if(!isKey(key, NUMBER) || value != value)
+            return false;
+        auto it = m_keys[key].numbers.find(value);
+        std::size_t label = (it != m_keys[key].numbers.end()) ? it->second : newLabel(key, value, std::string());
+        setLabel(gv, key, label);
+        return true;
+    }
+
+    //! Sets the value of a STRING key of the entity; returns false if the key is not a STRING key
+    bool setString(std::size_t gv, std::size_t key, const std::string &value)
+    {
+        if(!isKey(key, STRING))
+            return false;
+        auto it = m_keys[key].strings.find(value);
+        std::size_t label = (it != m_keys[key].strings.end()) ? it->second : newLabel(key, 0, value);
+        setLabel(gv, key, label);
+        return true;
+    }
+
+    //! Removes the value of the key from the entity; returns false if it has none
+    bool delProperty(std::size_t gv, std::size_t key)
+    {
+        std::vector<std::size_t> labels;
+        m_glc.getLabels(gv, labels);
+        auto it = findKey(labels, key);
+        if(it == labels.end())
+            return false;
+        labels.erase(it);
+        m_glc.setLabels(gv, labels);
+        return true;
+    }
+
+    //! Removes all the properties of the entity
+    void removeEntity(std::size_t gv)
+    {
+        m_glc.setLabels(gv, std::vector<std::size_t>());
+    }
+
+    //! Gets the value of a NUMBER key of the entity; returns false if it has none
+    bool getNumber(std::size_t gv, std::size_t key, double &value) const
+    {
+        std::size_t label = getLabel(gv, key);
+        if(!label || m_keys[key].type != NUMBER)
+            return false;
+        value = m_label2number[label];
+        return true;
+    }
+
+    //! Gets the value of a STRING key of the entity; returns false if it has none
+    bool getString(std::size_t gv, std::size_t key, std::string &value) const
+    {
+        std::size_t label = getLabel(gv, key);
+        if(!label || m_keys[key].type != STRING)
+            return false;
+        value = m_label2string[label];
+        return true;
+    }
+
+    //! Returns false if the predicate is not supported: LT/LE/GT/GE on a STRING key
+    bool isSupported(const Predicate &predicate) const
+    {
+        return !isKey(predicate.key, STRING) || predicate.op == EQ || predicate.op == NE;
+    }
+
+    //! Returns the sorted pair indexes whose property set satisfies the predicate; the pair indexes of the
+    //! qualifying values are gathered and sorted once. An unsupported predicate selects none
+    std::size_t getIndexes(const Predicate &predicate, std::vector<std::size_t> &indexes) const
+    {
+        std::vector<std::size_t> labels;
+        getLabels(predicate, labels);
+        getIndexes(labels, indexes);
+        return indexes.size();
+    }
+
+    //! Returns the entities satisfying all the predicates; the predicates are intersected on the pair indexes.
+    //! No predicates select every entity having at least one property; a NaN NUMBER predicate selects none.
+    //! Returns std::size_t(-1) with no entities if a predicate is not supported (see isSupported)
+    std::size_t find(const std::vector<Predicate> &predicates, std::vector<std::size_t> &ents) const
+    {
+        ents.clear();
+        for(auto &predicate : predicates)
+        {
+            if(!isSupported(predicate))
+                return std::size_t(-1);
+        }
+        std::vector<std::size_t> indexes, other, common;
+        if(predicates.empty())
+        {
+            std::vector<std::size_t> labels(m_label2key.size()-1);
+            for(std::size_t label = 1; label < m_label2key.size(); ++label)
+                labels[label-1] = label;
+            getIndexes(labels, indexes);
+        }
+        for(std::size_t i = 0; i < predicates.size(); ++i)
+        {
+            getIndexes(predicates[i], i ? other : indexes);
+            if(i)
+            {
+                SortedSets::intersect(indexes, other, common);
+                indexes.swap(common);
+            }
+            if(indexes.empty())
+                return 0;
+        }
+        for(auto index : indexes)
+            m_glc.getIndexEntities(index, ents, false);
+        return ents.size();
+    }
+
+    //! Returns the entities satisfying the predicate
+    std::size_t find(const Predicate &predicate, std::vector<std::size_t> &ents) const
+    {
+        return find(std::vector<Predicate>(1, predicate), ents);
+    }
+
+    //! Returns the underlying label container; the labels are the interned (key, value) pairs
+    const GraphLabelContainer &getContainer() const
+    {
+        return m_glc;
+    }
+
+    //! Prints the properties of the entity
+    void print(std::size_t gv, std::ostream &out = std::cout) const
+    {
+        std::vector<std::size_t> labels;
+        m_glc.getLabels(gv, labels);
+        out << gv << ":";
+        for(auto label : labels)
+        {
+            const Key &key = m_keys[m_label2key[label]];
+            out << " " << key.name << "=";
+            if(key.type == NUMBER)
+                out << m_label2number[label];
+            else
+                out << m_label2string[label];
+        }
+        out << std::endl;
+    }
+
+    //! Returns the memory occupied
+    std::size_t memory() const
+    {
+        std::size_t total = m_glc.memory() + SingleDLS::memory(m_label2key) + m_label2number.capacity()*sizeof(double);
+        for(auto &value : m_label2string)
+            total += sizeof(std::string) + value.capacity();
+        for(auto &key : m_keys)
+            total += sizeof(Key) + key.name.capacity() + key.numbers.size()*(sizeof(double) + sizeof(std::size_t) + 4*sizeof(void*)) +
+                     key.strings.size()*(sizeof(std::string) + sizeof(std::size_t) + 4*sizeof(void*));
+        return total;
+    }
+
+protected:
+    bool isKey(std::size_t key, Type type) const
+    {
+        return key && key < m_keys.size() && m_keys[key].type == type;
+    }
+
+    std::size_t newLabel(std::size_t key, double number, const std::string &text)
+    {
+        std::size_t label = m_label2key.size();
+        m_label2key.push_back(key);
+        m_label2number.push_back(number);
+        m_label2string.push_back(text);
+        if(m_keys[key].type == NUMBER)
+            m_keys[key].numbers[number] = label;
+        else
+            m_keys[key].strings[text] = label;
+        return label;
+    }
+
+    //! Returns the sorted distinct pair indexes of the labels
+    void getIndexes(const std::vector<std::size_t> &labels, std::vector<std::size_t> &indexes) const
+    {
+        indexes.clear();
+        for(auto label : labels)
+        {
+            const std::vector<std::size_t> &subsumed = m_glc.getSubsumedIndexes(label);
+            indexes.insert(indexes.end(), subsumed.begin(), subsumed.end());
+        }
+        std::sort(indexes.begin(), indexes.end());
+        indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+    }
+
+    //! Returns the position of the label of the key in the sorted labels
+    std::vector<std::size_t>::iterator findKey(std::vector<std::size_t> &labels, std::size_t key) const
+    {
+        return std::find_if(labels.begin(), labels.end(), [&](std::size_t label) { return m_label2key[label] == key; });
+    }
+
+    //! Returns the label of the key of the entity, 0 if none
+    std::size_t getLabel(std::size_t gv, std::size_t key) const
+    {
+        if(!key || key >= m_keys.size())
+            return 0;
+        for(auto label : m_glc.getIndexLabels(m_glc.getPairIndex(gv)))
+        {
+            if(m_label2key[label] == key)
+                return label;
+        }
+        return 0;
+    }
+
+    //! Replaces the value label of the key of the entity
+    void setLabel(std::size_t gv, std::size_t key, std::size_t label)
+    {
+        std::vector<std::size_t> labels;
+        m_glc.getLabels(gv, labels);
+        auto it = findKey(labels, key);
+        if(it != labels.end())
+        {
+            if(*it == label)
+                return;
+            labels.erase(it);
+        }
+        labels.insert(std::lower_bound(labels.begin(), labels.end(), label), label);
+        m_glc.setLabels(gv, labels);
+    }
+
+    //! Returns the sorted labels of the values satisfying the predicate
+    void getLabels(const Predicate &predicate, std::vector<std::size_t> &labels) const
+    {
+        labels.clear();
+        if(!predicate.key || predicate.key >= m_keys.size())
+            return;
+        const Key &key = m_keys[predicate.key];
+        if(key.type == NUMBER)
+        {
+            if(predicate.number != predicate.number)
+                return;
+            auto lo = key.numbers.begin(), hi = key.numbers.end();
+            switch(predicate.op)
+            {
+                case EQ: lo = key.numbers.lower_bound(predicate.number); hi = key.numbers.upper_bound(predicate.number); break;
+                case LT: hi = key.numbers.lower_bound(predicate.number); break;
+                case LE: hi = key.numbers.upper_bound(predicate.number); break;
+                case GT: lo = key.numbers.upper_bound(predicate.number); break;
+                case GE: lo = key.numbers.lower_bound(predicate.number); break;
+                case NE: break;
+            }
+            for(auto it = lo; it != hi; ++it)
+            {
+                if(predicate.op != NE || it->first != predicate.number)
+                    labels.push_back(it->second);
+            }
+        }
+        else if(!isSupported(predicate))
+            return;
+        else if(predicate.op == EQ)
+        {
+            auto it = key.strings.find(predicate.text);
+            if(it != key.strings.end())
+                labels.push_back(it->second);
+        }
+        else
+        {
+            for(auto &it : key.strings)
+            {
+                if(it.first != predicate.text)
+                    labels.push_back(it.second);
+            }
+        }
+        std::sort(labels.begin(), labels.end());
+    }
+};
+
+#endif
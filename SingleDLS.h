@@ -4,6 +4,9 @@
 #include <vector>
 #include <iostream>
 #include <ostream>
+#include <algorithm>
+#include <numeric>
+#include <thread>
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 /// Inspired and modified from the DLS Container introduced by the following citation:
 /// Karamete BK., Aubry, R., Mestreau E., Dey S., ‘A Novel Double Link Structure (DLS) with Application to
@@ -13,13 +16,31 @@
 /// Each graph entity has a label pair index, next entity that has the same index - m_list's one element
 /// Each pair index has a cached entity index;
 /// The purpose of this class is to have relationships of all labels belonging to each item w/o having to use a multimap
+/// Hybrid representation: long runs of consecutive items with the same pair index can be moved out of the chains into
+/// a sorted interval directory (see compact); their m_list slots are zeroed and m_list is trimmed after the last
+/// chained item. An item that leaves its interval is split out of it and goes back into a chain. The directory is
+/// also kept ordered by pair index so that the per label queries visit the label's own intervals only.
+/// Skip points: about every SKIP_DISTANCE chained items of a label, an item is kept with its rank counted from the
+/// chain tail (ranks do not change when items are linked at the head); the positional lookups start from the nearest
+/// skip point instead of the chain head (see select).
 /// Author: Karamete - Aug, 2023
 /// //////////////////////////////////////////////////////////////////////////////////////////////
 class SingleDLS {
+public:
+    enum : std::size_t
+    {
+        FORMAT_MARKER  = 0x534c44534c424c47ull, ///- not a plausible list size; tells the stream from the legacy one
+        FORMAT_VERSION = 1,                     ///- 1: interval directory
+        SKIP_DISTANCE  = 64                     ///- chained items between two skip points of a label
+    };
     
 protected:
 	std::vector<std::size_t> m_list;  ///- ith element has two values; the pair index for the ith entity and the next entity id
 	std::vector<std::size_t> m_cache; ///- pair index's cached entity index to start unraveling process
+	std::vector<std::size_t> m_count; ///- number of items associated with each pair index
+	std::vector<std::size_t> m_intervals; ///- sorted non-overlapping (first item, last item, pair index) triplets
+	std::vector<std::size_t> m_label_intervals; ///- the intervals as sorted (pair index, first item, last item) triplets
+	std::vector<std::vector<std::size_t>> m_skips; ///- per label (item, rank from the chain tail) pairs, ranks ascending
     
 public:
     /// C'tor
@@ -35,20 +56,46 @@ public:
     const std::vector<std::size_t> &get() const {return m_list;}
 
     /// Clears all
-    void clear() { m_list.clear(); m_cache.clear(); }
+    void clear() { m_list.clear(); m_cache.clear(); m_count.clear(); m_intervals.clear(); m_label_intervals.clear(); m_skips.clear(); }
 
     /// returns the pair index (label) of an entity item
     std::size_t get_label(std::size_t item) const
     {
-        return (2*item >= m_list.size() ? 0 : m_list[2*item]);
+        std::size_t label = (2*item >= m_list.size() ? 0 : m_list[2*item]);
+        if(label || m_intervals.empty())
+            return label;
+        std::size_t pos = find_interval(item);
+        return (pos < m_intervals.size()) ? m_intervals[pos+2] : 0;
     }
     
+    /// Gathers the pair indexes (labels) of n items in a row; the slots of the items distance ahead are prefetched
+    /// so that the random item lookups overlap
+    void get_labels(const std::size_t *items, std::size_t n, std::size_t *labels, std::size_t distance = 16) const
+    {
+        const std::size_t *list = m_list.data();
+        std::size_t size = m_list.size();
+        for(std::size_t i = 0; i < n; ++i)
+        {
+#if defined(__GNUC__)
+            if(i + distance < n && 2*items[i+distance] < size)
+                __builtin_prefetch(list + 2*items[i+distance]);
+#endif
+            std::size_t item = items[i];
+            std::size_t label = (2*item < size) ? list[2*item] : 0;
+            labels[i] = (label || m_intervals.empty()) ? label : get_label(item);
+        }
+    }
+
     /// inserts a pair index (label) to an item
     bool insert(std::size_t item, std::size_t label)
     {
         // get the label's cache
         if(label >= m_cache.size())
+        {
             m_cache.resize(label+1, 0);
+            m_count.resize(label+1, 0);
+            m_skips.resize(label+1);
+        }
         
         std::size_t cached = m_cache[label];
         
@@ -69,13 +116,22 @@ public:
         m_list[twoitem-1] = cached;
         
         m_cache[label] = item;
+        m_count[label]++;
+        push_skip(label, item, count_chained(label)-1);
         return true;
     }
     
     /// returns the number of items
     std::size_t size_items() const 
     {
-        return m_list.size()/2;
+        std::size_t num_items = m_list.size()/2;
+        return m_intervals.empty() ? num_items : std::max(num_items, m_intervals[m_intervals.size()-2]);
+    }
+
+    /// returns the number of intervals
+    std::size_t size_intervals() const
+    {
+        return m_intervals.size()/3;
     }
     
     /// returns the number of labels
@@ -88,13 +144,21 @@ public:
     void resize_labels(std::size_t old_index)
     {
         m_cache.resize(old_index);
+        m_count.resize(old_index);
+        m_skips.resize(old_index);
+    }
+
+    /// returns the number of items associated with a label
+    std::size_t count(std::size_t label) const
+    {
+        return (label < m_count.size()) ? m_count[label] : 0;
     }
 
     /// returns the items whose labels all deleted
     std::size_t size_deleted() const
     {
         std::size_t cnt = 0;
-        for(std::size_t i = 1; i <= m_list.size()/2; ++i)
+        for(std::size_t i = 1; i <= size_items(); ++i)
         {
            if(is_deleted(i)) ++cnt;
         }
@@ -107,39 +171,120 @@ public:
         std::size_t label = get_label(item);
         if(!label)
             return false;
+        if(2*item >= m_list.size() || !m_list[2*item])
+        {
+            split_interval(item);
+            m_count[label]--;
+            return true;
+        }
         std::size_t nextprev = m_list[2*item-1];        
         std::size_t cached = m_cache[label];
+        std::size_t rank = count_chained(label)-1; // of the head, then of the item
         
         if(cached == item)
             m_cache[label] = nextprev;        
+        else
+        {
+            while(std::size_t prev = m_list[2*cached-1])
+            {
+                --rank;
+                if(prev == item)
+                {
+                    m_list[2*cached-1] = nextprev;
+                    break;
+                }
+                cached = prev;
+            }
+        }
+        m_count[label]--;
         
         m_list[2*item] = 0;
         m_list[2*item-1] = 0;
         
-        while(std::size_t prev = m_list[2*cached-1])
+        std::vector<std::size_t> removed = { rank, nextprev };
+        unskip(label, removed);
+        return true;
+    }
+       
+    /// Moves the items all having the label from to the label to (0 deletes them) in bulk;
+    /// the chain of from is walked once instead of once per item. Returns the number of moved items
+    std::size_t move(const std::vector<std::size_t> &items, std::size_t from, std::size_t to)
+    {
+        if(from == to || items.empty())
+            return 0;
+        if(to >= m_cache.size())
         {
-            if(prev == item)
+            m_cache.resize(to+1, 0);
+            m_count.resize(to+1, 0);
+            m_skips.resize(to+1);
+        }
+        std::size_t rank = from ? count_chained(from) : 0; // of the walked chain item + 1
+        // mark the chained items and take the interval items out of their intervals
+        std::size_t nchained = 0;
+        for(auto item : items)
+        {
+            if(2*item < m_list.size() && m_list[2*item] == from && from)
             {
-                m_list[2*cached-1] = nextprev;
-                return true;
+                m_list[2*item] = to ? to : std::size_t(-1);
+                ++nchained;
             }
-            cached = prev;
+            else if(from)
+                split_interval(item);
         }
-        
-        return true;
+        // unlink the marked items with a single walk of the chain; their (rank, next item) go to the skip points
+        std::vector<std::size_t> removed;
+        for(std::size_t prev = 0, cur = (from ? m_cache[from] : 0); nchained && cur; )
+        {
+            std::size_t next = m_list[2*cur-1];
+            --rank;
+            if(m_list[2*cur] != from)
+            {
+                if(prev)
+                    m_list[2*prev-1] = next;
+                else
+                    m_cache[from] = next;
+                removed.push_back(rank);
+                removed.push_back(next);
+                --nchained;
+            }
+            else
+                prev = cur;
+            cur = next;
+        }
+        // link them into the chain of to
+        std::size_t chained = to ? count_chained(to) : 0;
+        for(auto item : items)
+        {
+            if(2*item >= m_list.size())
+                m_list.resize(2*item+1, 0);
+            m_list[2*item] = to;
+            m_list[2*item-1] = to ? m_cache[to] : 0;
+            if(to)
+            {
+                m_cache[to] = item;
+                push_skip(to, item, chained++);
+            }
+        }
+        if(from)
+        {
+            m_count[from] -= items.size();
+            unskip(from, removed);
+        }
+        if(to)
+            m_count[to] += items.size();
+        return items.size();
     }
-       
+    
     /// Returns true if the labels of an item is deleted
     bool is_deleted(std::size_t item) const
     {
-        std::size_t twoitem = 2*item;
-        return  (twoitem < m_list.size() ? (!m_list[twoitem] && !m_list[twoitem-1]) : false);
+        return (item && item <= size_items()) ? !get_label(item) : false;
     }
     
     /// Returns true if the label has no associated item
     bool is_deleted_label(std::size_t label) const
     {
-        return !m_cache[label];
+        return !count(label);
     }
     
     /// Returns the items associated with a label
@@ -150,17 +295,208 @@ public:
         if(label >= m_cache.size())
             return 0;
         std::size_t cached = m_cache[label];
+        std::size_t remaining = m_count[label];
         
-        if(!cached)
-            return 0;
-        items.push_back(cached);            
-        while(std::size_t prev = m_list[2*cached-1])
+        if(cached)
         {
-            items.push_back(prev);
-            cached = prev;
+            items.push_back(cached);            
+            --remaining;
+            while(std::size_t prev = m_list[2*cached-1])
+            {
+                items.push_back(prev);
+                cached = prev;
+                --remaining;
+            }
+        }
+        // the rest is in intervals
+        for(std::size_t i = find_label_interval(label, 0), end = find_label_interval(label+1, 0); remaining && i < end; i = i+3)
+        {
+            std::size_t n = m_label_intervals[i+2] - m_label_intervals[i+1] + 1;
+            items.resize(items.size() + n);
+            std::iota(items.end() - n, items.end(), m_label_intervals[i+1]);
+            remaining -= n;
         }
         return items.size();
     }
+
+    /// Returns the number of items of a label stored in intervals
+    std::size_t count_intervals(std::size_t label) const
+    {
+        std::size_t n = 0;
+        for(std::size_t i = find_label_interval(label, 0), end = find_label_interval(label+1, 0); i < end; i = i+3)
+            n += m_label_intervals[i+2] - m_label_intervals[i+1] + 1;
+        return n;
+    }
+
+    /// Returns the number of chained (not interval) items of a label
+    std::size_t count_chained(std::size_t label) const
+    {
+        return count(label) - (m_label_intervals.empty() ? 0 : count_intervals(label));
+    }
+
+    /// Appends the first limit items of a label in the order of get; only that much of the chain is walked
+    std::size_t head(std::size_t label, std::size_t limit, std::vector<std::size_t> &items) const
+    {
+        if(label >= m_cache.size())
+            return 0;
+        std::size_t n = 0;
+        for(std::size_t cached = m_cache[label]; cached && n < limit; cached = m_list[2*cached-1], ++n)
+            items.push_back(cached);
+        std::size_t remaining = std::min(limit, m_count[label]) - n;
+        for(std::size_t i = find_label_interval(label, 0), end = find_label_interval(label+1, 0); remaining && i < end; i = i+3)
+        {
+            std::size_t k = std::min(remaining, m_label_intervals[i+2] - m_label_intervals[i+1] + 1);
+            items.resize(items.size() + k);
+            std::iota(items.end() - k, items.end(), m_label_intervals[i+1]);
+            remaining -= k;
+            n += k;
+        }
+        return n;
+    }
+
+    /// Appends the items at the sorted positions (< count(label)) of a label in the order of get. The chain is walked up
+    /// to the last position falling in it, from the head or (skip) from the nearest skip point before each position;
+    /// the interval items are reached directly
+    std::size_t select(std::size_t label, const std::vector<std::size_t> &positions, std::vector<std::size_t> &items,
+                       bool skip = false) const
+    {
+        if(label >= m_cache.size() || positions.empty())
+            return 0;
+        std::size_t chained = count_chained(label);
+        const std::vector<std::size_t> &skips = m_skips[label];
+        std::size_t p = 0, pos = 0, cached = m_cache[label];
+        for(; cached && p < positions.size() && positions[p] < chained; ++p)
+        {
+            if(skip)
+            {
+                // the skip point of the smallest rank not below the one of the position
+                std::size_t rank = chained-1 - positions[p];
+                std::size_t lo = 0, hi = skips.size()/2;
+                while(lo < hi)
+                {
+                    std::size_t mid = (lo+hi)/2;
+                    if(skips[2*mid+1] < rank)
+                        lo = mid+1;
+                    else
+                        hi = mid;
+                }
+                if(2*lo < skips.size() && chained-1 - skips[2*lo+1] > pos)
+                {
+                    cached = skips[2*lo];
+                    pos = chained-1 - skips[2*lo+1];
+                }
+            }
+            for(; pos < positions[p]; ++pos)
+                cached = m_list[2*cached-1];
+            items.push_back(cached);
+        }
+        pos = chained;
+        for(std::size_t i = find_label_interval(label, 0), end = find_label_interval(label+1, 0); p < positions.size() && i < end; i = i+3)
+        {
+            std::size_t n = m_label_intervals[i+2] - m_label_intervals[i+1] + 1;
+            for(; p < positions.size() && positions[p] < pos + n; ++p)
+                items.push_back(m_label_intervals[i+1] + positions[p] - pos);
+            pos += n;
+        }
+        return p;
+    }
+
+    /// Visits the items associated with a label; on_item(item) for the chained items, on_range(first,last) for the intervals
+    template<class ItemFn, class RangeFn>
+    void visit(std::size_t label, ItemFn on_item, RangeFn on_range) const
+    {
+        if(label >= m_cache.size())
+            return;
+        std::size_t remaining = m_count[label];
+        for(std::size_t cached = m_cache[label]; cached; cached = m_list[2*cached-1])
+        {
+            on_item(cached);
+            --remaining;
+        }
+        for(std::size_t i = find_label_interval(label, 0), end = find_label_interval(label+1, 0); remaining && i < end; i = i+3)
+        {
+            on_range(m_label_intervals[i+1], m_label_intervals[i+2]);
+            remaining -= m_label_intervals[i+2] - m_label_intervals[i+1] + 1;
+        }
+    }
+
+    /// Moves the runs of at least min_run consecutive chained items with the same label into the interval directory
+    /// and trims m_list after the last chained item. Returns the number of intervals
+    std::size_t compact(std::size_t min_run)
+    {
+        if(min_run < 2)
+            min_run = 2;
+        std::vector<std::size_t> runs;
+        std::size_t num_items = m_list.size()/2;
+        for(std::size_t first = 1; first <= num_items; )
+        {
+            std::size_t label = m_list[2*first];
+            std::size_t last = first;
+            while(label && last < num_items && m_list[2*(last+1)] == label)
+                ++last;
+            if(label && last - first + 1 >= min_run)
+            {
+                runs.push_back(first);
+                runs.push_back(last);
+                runs.push_back(label);
+            }
+            first = last+1;
+        }
+        if(runs.empty())
+            return size_intervals();
+        for(std::size_t i = 0; i < runs.size(); i = i+3)
+        {
+            for(std::size_t item = runs[i]; item <= runs[i+1]; ++item)
+            {
+                m_list[2*item]   = 0;
+                m_list[2*item-1] = 0;
+            }
+        }
+        // merge into the directory; adjacent intervals of the same label are joined
+        std::vector<std::size_t> merged;
+        std::size_t i = 0, j = 0;
+        while(i < m_intervals.size() || j < runs.size())
+        {
+            const std::size_t *iv = nullptr;
+            if(j == runs.size() || (i < m_intervals.size() && m_intervals[i] < runs[j]))
+            {
+                iv = &m_intervals[i];
+                i = i+3;
+            }
+            else
+            {
+                iv = &runs[j];
+                j = j+3;
+            }
+            std::size_t n = merged.size();
+            if(n && merged[n-1] == iv[2] && merged[n-2]+1 == iv[0])
+                merged[n-2] = iv[1];
+            else
+                merged.insert(merged.end(), iv, iv+3);
+        }
+        m_intervals.swap(merged);
+        index_intervals();
+        relink();
+        return size_intervals();
+    }
+
+    /// Moves all the intervals back into the chains
+    void expand()
+    {
+        if(m_intervals.empty())
+            return;
+        std::size_t num_items = size_items();
+        if(2*num_items >= m_list.size())
+            m_list.resize(2*num_items+1, 0);
+        for(std::size_t i = 0; i < m_intervals.size(); i = i+3)
+        {
+            for(std::size_t item = m_intervals[i]; item <= m_intervals[i+1]; ++item)
+                m_list[2*item] = m_intervals[i+2];
+        }
+        m_intervals.clear();
+        m_label_intervals.clear();
+        relink();
+    }
     
     /// Prints all
     void print(std::ostream &out = std::cout) const
@@ -172,6 +508,11 @@ public:
         out << "Index Cached Node:" << std::endl;
         for(std::size_t i = 1; i < m_cache.size(); ++i)
             out << i << ": " << m_cache[i] << std::endl;
+        if(m_intervals.empty())
+            return;
+        out << "Intervals:" << std::endl;
+        for(std::size_t i = 0; i < m_intervals.size(); i = i+3)
+            out << m_intervals[i] << "-" << m_intervals[i+1] << ": " << m_intervals[i+2] << std::endl;
     }
     
     /// Prints the label's associated items
@@ -193,6 +534,72 @@ public:
         }
     }
 
+    /// Renumbers the items; perm[old item] = new item. Intervals are expanded and chains are rebuilt in decreasing new item order
+    void permute(const std::vector<std::size_t> &perm)
+    {
+        expand();
+        std::vector<std::size_t> list(std::max(m_list.size(), perm.empty() ? 0 : 2*perm.size()-1), 0);
+        for(std::size_t item = 1; item < perm.size() && 2*item < m_list.size(); ++item)
+            list[2*perm[item]] = m_list[2*item];
+        m_list.swap(list);
+        relink();
+    }
+
+    /// Rebuilds the container from the label of each item (labels[item], 0 if none, labels[0] unused).
+    /// The chains of num_threads item ranges are linked in parallel and then stitched per label in range order,
+    /// giving the same decreasing item order as relink
+    void assign(const std::vector<std::size_t> &labels, std::size_t num_labels, std::size_t num_threads = 1)
+    {
+        clear();
+        std::size_t num_items = labels.empty() ? 0 : labels.size()-1;
+        while(num_items && !labels[num_items])
+            --num_items;
+        if(!num_items)
+            return;
+        m_list.assign(2*num_items+1, 0);
+        m_cache.assign(num_labels+1, 0);
+        m_count.assign(num_labels+1, 0);
+        num_threads = std::max<std::size_t>(1, std::min(num_threads, num_items/4096));
+        // (lowest item, highest item, count) of each label in each range
+        std::vector<std::vector<std::size_t>> ranges(num_threads, std::vector<std::size_t>(3*(num_labels+1), 0));
+        auto link = [&](std::size_t t)
+        {
+            std::vector<std::size_t> &range = ranges[t];
+            std::size_t first = 1 + t*num_items/num_threads, last = (t+1)*num_items/num_threads;
+            for(std::size_t item = first; item <= last; ++item)
+            {
+                std::size_t label = labels[item];
+                if(!label || label > num_labels)
+                    continue;
+                m_list[2*item]   = label;
+                m_list[2*item-1] = range[3*label+1];
+                if(!range[3*label])
+                    range[3*label] = item;
+                range[3*label+1] = item;
+                range[3*label+2]++;
+            }
+        };
+        std::vector<std::thread> threads;
+        for(std::size_t t = 1; t < num_threads; ++t)
+            threads.emplace_back(link, t);
+        link(0);
+        for(auto &thread : threads)
+            thread.join();
+        for(std::size_t t = 0; t < num_threads; ++t)
+        {
+            for(std::size_t label = 1; label <= num_labels; ++label)
+            {
+                const std::size_t *range = &ranges[t][3*label];
+                if(!range[0])
+                    continue;
+                m_list[2*range[0]-1] = m_cache[label];
+                m_cache[label] = range[1];
+                m_count[label] += range[2];
+            }
+        }
+        index_skips();
+    }
+
     /// Inserts the tuples of item,label pairs
     void populate(const std::vector<std::size_t> &pairs) 
     {
@@ -201,25 +608,61 @@ public:
             insert(pairs[i], pairs[i+1]);        
     }
     
-    /// Serialized write to a binary output stream
+    /// Serialized write to a binary output stream; a format marker and version precede the lists
     void write(std::ostream &out) const
     {
+        std::size_t header[2] = { FORMAT_MARKER, FORMAT_VERSION };
+        out.write((char*)header, sizeof(header));
         write(out, m_list);
         write(out, m_cache);
+        write(out, m_intervals);
     }
     
-    /// Serialized read from a binary input stream
+    /// Serialized read from a binary input stream. Streams written before the format marker was added (no interval
+    /// directory) are read as such; a newer version than FORMAT_VERSION sets the failbit
     void read(std::istream &in)
     {
         clear();
-        read(in, m_list);
+        std::size_t word = 0, version = 0;
+        in.read((char*)&word, sizeof(std::size_t));
+        if(word == FORMAT_MARKER)
+        {
+            in.read((char*)&version, sizeof(std::size_t));
+            if(version > FORMAT_VERSION)
+            {
+                in.setstate(std::ios::failbit);
+                return;
+            }
+            read(in, m_list);
+        }
+        else if(word && in)
+        {
+            // legacy stream: word is the size of m_list
+            m_list.resize(word);
+            in.read((char*)&m_list[0], word*sizeof(std::size_t));
+        }
         read(in, m_cache);
+        if(version >= 1)
+            read(in, m_intervals);
+        index_intervals();
+        m_count.assign(m_cache.size(), 0);
+        for(std::size_t i = 2; i < m_list.size(); i = i+2)
+        {
+            if(m_list[i] < m_count.size())
+                m_count[m_list[i]]++;
+        }
+        for(std::size_t i = 0; i < m_intervals.size(); i = i+3)
+        {
+            if(m_intervals[i+2] < m_count.size())
+                m_count[m_intervals[i+2]] += m_intervals[i+1] - m_intervals[i] + 1;
+        }
+        index_skips();
     }
     
     /// Returns the memory occupied
     std::size_t memory() const
     {
-        return memory(m_list) + memory(m_cache);
+        return memory(m_list) + memory(m_cache) + memory(m_count) + memory(m_intervals) + memory(m_label_intervals) + memory(m_skips);
     }
     
     /// Utils
@@ -231,7 +674,7 @@ public:
     static std::size_t memory(const std::vector<std::vector<std::size_t>> &vecs)
     {
         std::size_t total = sizeof(std::vector<std::vector<std::size_t>>) + vecs.capacity()*sizeof(std::vector<std::size_t>);
-        for(auto vec : vecs)
+        for(auto &vec : vecs)
             total += memory(vec);
         return total;
     }    
@@ -261,6 +704,171 @@ public:
     {
         m_list.reserve(2*num_items+1);
     }
+
+protected:
+    /// Returns the position of the interval containing the item in the directory or its size if none
+    std::size_t find_interval(std::size_t item) const
+    {
+        std::size_t lo = 0, hi = m_intervals.size()/3;
+        while(lo < hi)
+        {
+            std::size_t mid = (lo+hi)/2;
+            if(m_intervals[3*mid+1] < item)
+                lo = mid+1;
+            else
+                hi = mid;
+        }
+        return (lo < m_intervals.size()/3 && m_intervals[3*lo] <= item) ? 3*lo : m_intervals.size();
+    }
+
+    /// Takes the item out of its interval
+    void split_interval(std::size_t item)
+    {
+        std::size_t pos = find_interval(item);
+        if(pos == m_intervals.size())
+            return;
+        std::size_t first = m_intervals[pos], last = m_intervals[pos+1], label = m_intervals[pos+2];
+        std::size_t at = find_label_interval(label, first);
+        if(first == last)
+        {
+            m_intervals.erase(m_intervals.begin()+pos, m_intervals.begin()+pos+3);
+            m_label_intervals.erase(m_label_intervals.begin()+at, m_label_intervals.begin()+at+3);
+        }
+        else if(item == first)
+        {
+            m_intervals[pos] = item+1;
+            m_label_intervals[at+1] = item+1;
+        }
+        else if(item == last)
+        {
+            m_intervals[pos+1] = item-1;
+            m_label_intervals[at+2] = item-1;
+        }
+        else
+        {
+            m_intervals[pos+1] = item-1;
+            m_label_intervals[at+2] = item-1;
+            std::size_t right[3] = { item+1, last, label };
+            m_intervals.insert(m_intervals.begin()+pos+3, right, right+3);
+            std::size_t label_right[3] = { label, item+1, last };
+            m_label_intervals.insert(m_label_intervals.begin()+at+3, label_right, label_right+3);
+        }
+    }
+
+    /// Returns the position of the first (pair index, first item, last item) triplet not before (label, first)
+    std::size_t find_label_interval(std::size_t label, std::size_t first) const
+    {
+        std::size_t lo = 0, hi = m_label_intervals.size()/3;
+        while(lo < hi)
+        {
+            std::size_t mid = (lo+hi)/2;
+            const std::size_t *iv = &m_label_intervals[3*mid];
+            if(iv[0] < label || (iv[0] == label && iv[1] < first))
+                lo = mid+1;
+            else
+                hi = mid;
+        }
+        return 3*lo;
+    }
+
+    /// Rebuilds the by pair index order of the interval directory
+    void index_intervals()
+    {
+        std::size_t n = m_intervals.size()/3;
+        std::vector<std::size_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b)
+        {
+            return m_intervals[3*a+2] < m_intervals[3*b+2] || (m_intervals[3*a+2] == m_intervals[3*b+2] && m_intervals[3*a] < m_intervals[3*b]);
+        });
+        m_label_intervals.resize(3*n);
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            m_label_intervals[3*i]   = m_intervals[3*order[i]+2];
+            m_label_intervals[3*i+1] = m_intervals[3*order[i]];
+            m_label_intervals[3*i+2] = m_intervals[3*order[i]+1];
+        }
+    }
+
+    /// Rebuilds the chains from the labels in m_list in decreasing item order and trims m_list after the last chained item
+    void relink()
+    {
+        std::fill(m_cache.begin(), m_cache.end(), 0);
+        std::size_t last = 0;
+        for(std::size_t item = 1; 2*item < m_list.size(); ++item)
+        {
+            std::size_t label = m_list[2*item];
+            if(!label)
+                continue;
+            m_list[2*item-1] = m_cache[label];
+            m_cache[label] = item;
+            last = item;
+        }
+        m_list.resize(last ? 2*last+1 : 0);
+        m_list.shrink_to_fit();
+        index_skips();
+    }
+
+    /// Makes the new chain head item of the label (rank from the tail) a skip point if the last one is far enough
+    void push_skip(std::size_t label, std::size_t item, std::size_t rank)
+    {
+        std::vector<std::size_t> &skips = m_skips[label];
+        if(rank >= (skips.empty() ? 0 : skips.back()) + SKIP_DISTANCE)
+        {
+            skips.push_back(item);
+            skips.push_back(rank);
+        }
+    }
+
+    /// Accounts the chained items removed from the label in the skip points; removed holds (rank before the removal,
+    /// next item down the chain) pairs in decreasing rank order. A removed skip point is replaced with its next item
+    /// unless that one is removed too
+    void unskip(std::size_t label, const std::vector<std::size_t> &removed)
+    {
+        std::vector<std::size_t> &skips = m_skips[label];
+        if(skips.empty() || removed.empty())
+            return;
+        std::size_t n = removed.size()/2, r = n, out = 0; // removed[2*(r-1)] ... are the ranks below the skip point
+        for(std::size_t i = 0; i < skips.size(); i = i+2)
+        {
+            std::size_t item = skips[i], rank = skips[i+1];
+            while(r && removed[2*(r-1)] < rank)
+                --r;
+            std::size_t below = n - r; // removed ranks below
+            if(r && removed[2*(r-1)] == rank)
+            {
+                // rank-1 is the next item; replaced if it stays
+                if(!rank || (r < n && removed[2*r] == rank-1) || !removed[2*(r-1)+1])
+                    continue;
+                item = removed[2*(r-1)+1];
+                --rank;
+            }
+            rank -= below;
+            if(out && skips[out-1] >= rank)
+                continue;
+            skips[out++] = item;
+            skips[out++] = rank;
+        }
+        skips.resize(out);
+    }
+
+    /// Rebuilds the skip points of all the labels from their chains
+    void index_skips()
+    {
+        m_skips.assign(m_cache.size(), std::vector<std::size_t>());
+        std::vector<std::size_t> chain;
+        for(std::size_t label = 1; label < m_cache.size(); ++label)
+        {
+            chain.clear();
+            for(std::size_t cached = m_cache[label]; cached; cached = m_list[2*cached-1])
+                chain.push_back(cached);
+            for(std::size_t rank = SKIP_DISTANCE; rank < chain.size(); rank += SKIP_DISTANCE)
+            {
+                m_skips[label].push_back(chain[chain.size()-1 - rank]);
+                m_skips[label].push_back(rank);
+            }
+        }
+    }
 };
 
 #endif
@@ -0,0 +1,344 @@
+#ifndef __SORTEDSETS_H__
+#define __SORTEDSETS_H__
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <atomic>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SORTEDSETS_SIMD 1
+#define SORTEDSETS_TARGET(isa) __attribute__((target(isa)))
+#define SORTEDSETS_KERNEL inline __attribute__((always_inline))
+#else
+#define SORTEDSETS_SIMD 0
+#define SORTEDSETS_KERNEL inline
+#endif
+/*!
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Set kernels on sorted unique std::size_t arrays such as the labels of a pair index or the pair indexes of a label
+/// Intersection, difference and subset tests compare a block of W ids of one set against a block of W ids of the other
+/// all-to-all in registers (W = 4 with AVX2, 2 with SSE4.1, std merge algorithms otherwise) and advance the block with the
+/// smaller maximum. A partially matched block is finished by the scalar tail.
+/// The union is a merge; containment uses a register scan for short sets and a binary search otherwise.
+/// The SSE4.1/AVX2 kernels are compiled per function (target attributes) whatever the build flags and the widest one
+/// the CPU supports is picked at run time --> See useWidth
+/// //////////////////////////////////////////////////////////////////////////////////////////////
+*/
+class SortedSets {
+protected:
+    //! Block width of the kernels in use; 0 until detected (constant initialized, so usable from static initializers)
+    template<class T = void>
+    struct Width
+    {
+        static std::atomic<std::size_t> value;
+    };
+
+public:
+    //! out = a U b
+    static std::size_t unite(const std::vector<std::size_t> &a, const std::vector<std::size_t> &b, std::vector<std::size_t> &out)
+    {
+        out.resize(a.size() + b.size());
+        std::size_t i = 0, j = 0, n = 0;
+        while(i < a.size() && j < b.size())
+        {
+            std::size_t x = a[i], y = b[j];
+            out[n++] = (x <= y) ? x : y;
+            i += (x <= y);
+            j += (y <= x);
+        }
+        while(i < a.size())
+            out[n++] = a[i++];
+        while(j < b.size())
+            out[n++] = b[j++];
+        out.resize(n);
+        return n;
+    }
+
+    //! out = a ^ b
+    static std::size_t intersect(const std::vector<std::size_t> &a, const std::vector<std::size_t> &b, std::vector<std::size_t> &out)
+    {
+        out.resize(std::min(a.size(), b.size()));
+        if(out.empty())
+            return 0;
+        if(width() == 1)
+            out.resize(std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), out.begin()) - out.begin());
+        else
+            out.resize(dispatch<INTERSECT>(a.data(), a.size(), b.data(), b.size(), out.data()));
+        return out.size();
+    }
+
+    //! out = a - b
+    static std::size_t subtract(const std::vector<std::size_t> &a, const std::vector<std::size_t> &b, std::vector<std::size_t> &out)
+    {
+        out.resize(a.size());
+        if(out.empty())
+            return 0;
+        if(width() == 1)
+            out.resize(std::set_difference(a.begin(), a.end(), b.begin(), b.end(), out.begin()) - out.begin());
+        else
+            out.resize(dispatch<DIFFERENCE>(a.data(), a.size(), b.data(), b.size(), out.data()));
+        return out.size();
+    }
+
+    //! Returns true if all ids of a are in b
+    static bool isSubset(const std::vector<std::size_t> &a, const std::vector<std::size_t> &b)
+    {
+        if(a.size() > b.size())
+            return false;
+        if(b.size() <= 16)
+            return scan(a.data(), a.size(), b.data(), b.size());
+        if(width() == 1)
+            return std::includes(b.begin(), b.end(), a.begin(), a.end());
+        return dispatch<SUBSET>(a.data(), a.size(), b.data(), b.size(), nullptr) != 0;
+    }
+
+    //! Returns true if the id is in a
+    static bool contains(const std::vector<std::size_t> &a, std::size_t id)
+    {
+        if(a.size() > 16)
+            return std::binary_search(a.begin(), a.end(), id);
+        return scan(&id, 1, a.data(), a.size());
+    }
+
+    //! Inserts the id keeping a sorted; returns false if it exists
+    static bool insert(std::vector<std::size_t> &a, std::size_t id)
+    {
+        auto it = std::lower_bound(a.begin(), a.end(), id);
+        if(it != a.end() && *it == id)
+            return false;
+        a.insert(it, id);
+        return true;
+    }
+
+    //! Erases the id from a; returns false if it does not exist
+    static bool erase(std::vector<std::size_t> &a, std::size_t id)
+    {
+        auto it = std::lower_bound(a.begin(), a.end(), id);
+        if(it == a.end() || *it != id)
+            return false;
+        a.erase(it);
+        return true;
+    }
+
+    //! Returns the name of the instruction set of the kernels in use
+    static const char *isa()
+    {
+        return (width() == 4) ? "avx2" : (width() == 2) ? "sse4" : "scalar";
+    }
+
+    //! Selects the kernels of the block width (1: scalar, 2: SSE4.1, 4: AVX2); 0 restores the widest one the CPU
+    //! supports. Returns false, leaving the kernels as they are, if the CPU does not support the width. Not
+    //! synchronized: select before the sets are used concurrently
+    static bool useWidth(std::size_t w)
+    {
+        if(!w)
+            w = supportedWidth();
+        if((w != 1 && w != 2 && w != 4) || w > supportedWidth())
+            return false;
+        Width<>::value.store(w, std::memory_order_relaxed);
+        return true;
+    }
+
+protected:
+    enum { INTERSECT, DIFFERENCE, SUBSET };
+
+    //! Returns the widest block width the CPU supports
+    static std::size_t supportedWidth()
+    {
+#if SORTEDSETS_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return 4;
+        if(__builtin_cpu_supports("sse4.1"))
+            return 2;
+#endif
+        return 1;
+    }
+
+    //! Block width of the kernels in use, detected on the first call
+    static std::size_t width()
+    {
+        std::size_t w = Width<>::value.load(std::memory_order_relaxed);
+        if(!w)
+        {
+            w = supportedWidth();
+            Width<>::value.store(w, std::memory_order_relaxed);
+        }
+        return w;
+    }
+
+    //! Returns true if all the ids are in the short set b (register scans)
+    static bool scan(const std::size_t *ids, std::size_t n, const std::size_t *b, std::size_t nb)
+    {
+#if SORTEDSETS_SIMD
+        std::size_t w = width();
+        if(w == 4)
+            return scan4(ids, n, b, nb);
+        if(w == 2)
+            return scan2(ids, n, b, nb);
+#endif
+        for(std::size_t k = 0; k < n; ++k)
+        {
+            if(std::find(b, b+nb, ids[k]) == b+nb)
+                return false;
+        }
+        return true;
+    }
+
+    template<int MODE>
+    static std::size_t dispatch(const std::size_t *a, std::size_t na, const std::size_t *b, std::size_t nb, std::size_t *out)
+    {
+#if SORTEDSETS_SIMD
+        if(width() == 4)
+            return kernel4<MODE>(a, na, b, nb, out);
+        if(width() == 2)
+            return kernel2<MODE>(a, na, b, nb, out);
+#endif
+        return kernel<MODE, 1, Mask1>(a, na, b, nb, out);
+    }
+
+    //! Returns the bit mask of the ids of the block of a that appear in the block of b
+    struct Mask1
+    {
+        static unsigned get(const std::size_t *a, const std::size_t *b)
+        {
+            return a[0] == b[0];
+        }
+    };
+
+#if SORTEDSETS_SIMD
+    static SORTEDSETS_TARGET("avx2") unsigned blockMask4(const std::size_t *a, const std::size_t *b)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i*)a);
+        __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+        __m256i m = _mm256_cmpeq_epi64(va, vb);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0,3,2,1))));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(1,0,3,2))));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(2,1,0,3))));
+        return unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+    }
+
+    static SORTEDSETS_TARGET("sse4.1") unsigned blockMask2(const std::size_t *a, const std::size_t *b)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)a);
+        __m128i vb = _mm_loadu_si128((const __m128i*)b);
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi64(va, vb), _mm_cmpeq_epi64(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1,0,3,2))));
+        return unsigned(_mm_movemask_pd(_mm_castsi128_pd(m)));
+    }
+
+    struct Mask4
+    {
+        static unsigned get(const std::size_t *a, const std::size_t *b)
+        {
+            return blockMask4(a, b);
+        }
+    };
+
+    struct Mask2
+    {
+        static unsigned get(const std::size_t *a, const std::size_t *b)
+        {
+            return blockMask2(a, b);
+        }
+    };
+
+    //! The block merge compiled for AVX2; the kernel and the masks are inlined into it
+    template<int MODE>
+    static SORTEDSETS_TARGET("avx2") std::size_t kernel4(const std::size_t *a, std::size_t na, const std::size_t *b, std::size_t nb, std::size_t *out)
+    {
+        return kernel<MODE, 4, Mask4>(a, na, b, nb, out);
+    }
+
+    //! The block merge compiled for SSE4.1
+    template<int MODE>
+    static SORTEDSETS_TARGET("sse4.1") std::size_t kernel2(const std::size_t *a, std::size_t na, const std::size_t *b, std::size_t nb, std::size_t *out)
+    {
+        return kernel<MODE, 2, Mask2>(a, na, b, nb, out);
+    }
+
+    static SORTEDSETS_TARGET("avx2") bool scan4(const std::size_t *ids, std::size_t n, const std::size_t *b, std::size_t nb)
+    {
+        for(std::size_t k = 0; k < n; ++k)
+        {
+            std::size_t i = 0;
+            bool found = false;
+            __m256i v = _mm256_set1_epi64x((long long)ids[k]);
+            for(; i + 4 <= nb && !found; i += 4)
+                found = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, _mm256_loadu_si256((const __m256i*)(b+i))))) != 0;
+            for(; i < nb && !found; ++i)
+                found = (b[i] == ids[k]);
+            if(!found)
+                return false;
+        }
+        return true;
+    }
+
+    static SORTEDSETS_TARGET("sse4.1") bool scan2(const std::size_t *ids, std::size_t n, const std::size_t *b, std::size_t nb)
+    {
+        for(std::size_t k = 0; k < n; ++k)
+        {
+            std::size_t i = 0;
+            bool found = false;
+            __m128i v = _mm_set1_epi64x((long long)ids[k]);
+            for(; i + 2 <= nb && !found; i += 2)
+                found = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, _mm_loadu_si128((const __m128i*)(b+i))))) != 0;
+            for(; i < nb && !found; ++i)
+                found = (b[i] == ids[k]);
+            if(!found)
+                return false;
+        }
+        return true;
+    }
+#endif
+
+    //! Block merge of a against b; writes the matched (INTERSECT) or unmatched (DIFFERENCE) ids of a into out
+    //! For SUBSET returns 1 if all ids of a are matched, 0 otherwise. It is inlined into the kernel of each width
+    template<int MODE, std::size_t W, class Mask>
+    static SORTEDSETS_KERNEL std::size_t kernel(const std::size_t *a, std::size_t na, const std::size_t *b, std::size_t nb, std::size_t *out)
+    {
+        std::size_t i = 0, j = 0, n = 0;
+        unsigned mask = 0;
+        if(W > 1)
+        {
+            const unsigned full = (1u << W) - 1;
+            while(i + W <= na && j + W <= nb)
+            {
+                mask |= Mask::get(a+i, b+j);
+                std::size_t amax = a[i+W-1], bmax = b[j+W-1];
+                if(amax <= bmax)
+                {
+                    if(MODE == SUBSET && mask != full)
+                        return 0;
+                    for(unsigned m = (MODE == INTERSECT) ? mask : (~mask & full); MODE != SUBSET && m; m &= m-1)
+                        out[n++] = a[i + __builtin_ctz(m)];
+                    i += W;
+                    mask = 0;
+                }
+                j += (bmax <= amax) ? W : 0;
+            }
+        }
+        // scalar tail; the ids of the current block of a matched by the previous blocks of b are in mask
+        for(; i < na; ++i, mask >>= 1)
+        {
+            bool matched = mask & 1;
+            if(!matched)
+            {
+                while(j < nb && b[j] < a[i])
+                    ++j;
+                matched = (j < nb && b[j] == a[i]);
+            }
+            if(MODE == SUBSET && !matched)
+                return 0;
+            if(MODE != SUBSET && matched == (MODE == INTERSECT))
+                out[n++] = a[i];
+        }
+        return (MODE == SUBSET) ? 1 : n;
+    }
+};
+
+template<class T>
+std::atomic<std::size_t> SortedSets::Width<T>::value(0);
+
+#endif
@@ -2,7 +2,14 @@
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <set>
+#include <chrono>
+#include <thread>
+#include <limits>
 #include "GraphLabelContainer.h"
+#include "LabelIngest.h"
+#include "LabelPathIndex.h"
+#include "PropertyContainer.h"
 /*!
 ////////////////////////////////////////////////////////////////////////////////////////////
 /// One graph entity to many labels - many Labels to any graph entities 
@@ -189,6 +196,1698 @@ int test_A241_label_container(std::ostream &out)
     return 1;
 }
 
+int test_label_hierarchy(std::ostream &out)
+{
+    // self=1, ceo=2, principal=3, expert=4, master=5, vp=6, executive=7, staff=8
+    GraphLabelContainer glc;
+    glc.addLabel(1,4);
+    glc.addLabel(1,1);
+    glc.addLabel(2,6);
+    glc.addLabel(2,4);
+    glc.addLabel(3,4);
+    glc.addLabel(3,5);
+    glc.addLabel(4,2);
+    
+    // register the hierarchy after some tuples exist; vp and ceo are executives, executives are staff
+    if(!glc.addIsA(6,7) || !glc.addIsA(2,7) || !glc.addIsA(7,8) || glc.addIsA(8,6))
+    {
+        out << "is-a registration failed" << std::endl;
+        return 0;
+    }
+    glc.addLabel(5,3);
+    glc.addLabel(5,6);
+    glc.addLabel(6,7);
+    
+    std::vector<std::size_t> ents;
+    glc.getSubsumedEntities(7, ents);
+    std::sort(ents.begin(), ents.end());
+    out << "executives: ";
+    for(auto ent : ents)
+        out << ent << " ";
+    out << std::endl;
+    if(ents != std::vector<std::size_t>({2,4,5,6}))
+        return 0;
+    
+    // tuples get recycled and re-created; the closure has to follow
+    glc.delLabel(4,2);
+    glc.addLabel(1,2);
+    glc.delLabel(5,6);
+    glc.getSubsumedEntities(8, ents);
+    std::sort(ents.begin(), ents.end());
+    if(ents != std::vector<std::size_t>({1,2,6}))
+        return 0;
+    
+    // a flat query on a leaf label is unchanged
+    glc.getSubsumedEntities(4, ents);
+    std::sort(ents.begin(), ents.end());
+    if(ents != std::vector<std::size_t>({1,2,3}))
+        return 0;
+    
+    // the closures are rebuilt on read
+    std::stringstream ss;
+    glc.write(ss);
+    glc.read(ss);
+    glc.getSubsumedEntities(7, ents);
+    std::sort(ents.begin(), ents.end());
+    if(ents != std::vector<std::size_t>({1,2,6}))
+        return 0;
+
+    // the hierarchy survives clear
+    GraphLabelContainer other;
+    other.addIsA(2,1);
+    other.clear();
+    other.addLabel(5,2);
+    other.getSubsumedEntities(1, ents);
+    return ents == std::vector<std::size_t>({5});
+}
+
+int test_label_cooccurrence(std::ostream &out)
+{
+    GraphLabelContainer glc;
+    std::size_t num_entities = 2000, num_labels = 12;
+    std::srand(7);
+    for(std::size_t step = 0; step < 20000; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % num_entities;
+        std::size_t label = 1 + std::rand() % num_labels;
+        if(std::rand() % 3)
+            glc.addLabel(gv, label);
+        else if(glc.hasLabel(gv, label))
+            glc.delLabel(gv, label);
+        if(step % 5000 == 0)
+        {
+            std::vector<std::size_t> edges;
+            glc.getCooccurrence(edges);
+        }
+    }
+    glc.removeEntityFromLabels(5);
+    
+    // brute force over the entities
+    std::map<std::pair<std::size_t, std::size_t>, std::size_t> trusted;
+    std::vector<std::size_t> labels;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        glc.getLabels(gv, labels);
+        for(std::size_t i = 0; i < labels.size(); ++i)
+            for(std::size_t j = i+1; j < labels.size(); ++j)
+                trusted[{labels[i], labels[j]}]++;
+    }
+    std::vector<std::size_t> edges;
+    std::size_t nedges = glc.getCooccurrence(edges);
+    out << "Co-occurrence edges = " << nedges << std::endl;
+    if(nedges != trusted.size())
+        return 0;
+    for(std::size_t i = 0; i < edges.size(); i = i+3)
+    {
+        if(trusted[{edges[i], edges[i+1]}] != edges[i+2])
+            return 0;
+    }
+    std::vector<std::size_t> offsets, adjacency, weights, ents;
+    glc.getCooccurrence(offsets, adjacency, weights);
+    if(adjacency.size() != 2*nedges)
+        return 0;
+    for(std::size_t label = 1; label <= num_labels; ++label)
+    {
+        if(glc.getLabelCount(label) != glc.getEntities(label, ents))
+            return 0;
+        for(std::size_t i = offsets[label]; i < offsets[label+1]; ++i)
+        {
+            std::size_t a = std::min(label, adjacency[i]), b = std::max(label, adjacency[i]);
+            out << label << "-" << adjacency[i] << ": " << 100.0*weights[i]/glc.getLabelCount(label) << "%" << std::endl;
+            if(trusted[{a,b}] != weights[i])
+                return 0;
+        }
+    }
+    // concurrent readers bring the dirtied weights up to date once
+    glc.removeEntityFromLabels(1);
+    glc.addLabel(2, num_labels);
+    std::vector<std::vector<std::size_t>> results(4);
+    std::vector<std::thread> readers;
+    for(auto &result : results)
+        readers.emplace_back([&glc, &result]() { glc.getCooccurrence(result); });
+    for(auto &reader : readers)
+        reader.join();
+    glc.getCooccurrence(edges);
+    for(auto &result : results)
+    {
+        if(result != edges)
+            return 0;
+    }
+    return 1;
+}
+
+int test_entity_renumbering(std::ostream &out)
+{
+    GraphLabelContainer glc;
+    std::size_t num_entities = 1000, num_labels = 6;
+    std::srand(11);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        if(gv % 10 == 0)
+            continue; // some unlabeled entities
+        glc.addLabel(gv, 1 + std::rand() % num_labels);
+        if(std::rand() % 2)
+            glc.addLabel(gv, 1 + std::rand() % num_labels);
+    }
+    std::vector<std::vector<std::size_t>> before(num_entities+1);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+        glc.getLabels(gv, before[gv]);
+    
+    // labels 4..6 are clustered first
+    std::vector<std::size_t> clusters = { 0, 1, 1, 1, 0, 0, 0 };
+    std::vector<std::size_t> perm;
+    glc.renumber(perm, &clusters);
+    
+    std::vector<std::size_t> labels;
+    std::vector<char> used(perm.size(), 0);
+    for(std::size_t gv = 1; gv < perm.size(); ++gv)
+    {
+        if(used[perm[gv]]++)
+            return 0;
+        glc.getLabels(perm[gv], labels);
+        if(labels != before[gv])
+            return 0;
+    }
+    // each labels set is a contiguous range and cluster 0 comes first
+    std::vector<std::size_t> ents, prev;
+    bool cluster1 = false;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        glc.getLabels(gv, labels);
+        if(labels.empty())
+            break;
+        bool c0 = labels.back() >= 4;
+        if(c0 && cluster1)
+            return 0;
+        cluster1 = !c0;
+        if(labels != prev)
+        {
+            glc.getEntities(labels, ents);
+            std::sort(ents.begin(), ents.end());
+            out << "range " << ents.front() << "-" << ents.back() << std::endl;
+            if(ents.front() != gv || ents.back() - ents.front() + 1 != ents.size())
+                return 0;
+        }
+        prev = labels;
+    }
+    return glc.getEntities(1, ents) > 0;
+}
+
+//! Compares the labels of each entity and the entities of each label with a reference model
+bool check_labels(const GraphLabelContainer &glc, const std::vector<std::vector<std::size_t>> &model, std::size_t num_labels)
+{
+    std::vector<std::size_t> labels, ents;
+    std::vector<std::vector<std::size_t>> trusted(num_labels+1);
+    for(std::size_t gv = 1; gv < model.size(); ++gv)
+    {
+        glc.getLabels(gv, labels);
+        if(labels != model[gv] || glc.hasLabel(gv) != !model[gv].empty())
+            return false;
+        for(auto label : model[gv])
+            trusted[label].push_back(gv);
+    }
+    for(std::size_t label = 1; label <= num_labels; ++label)
+    {
+        glc.getEntities(label, ents);
+        std::sort(ents.begin(), ents.end());
+        if(ents != trusted[label])
+            return false;
+    }
+    return true;
+}
+
+int test_interval_tuples(std::ostream &out)
+{
+    GraphLabelContainer glc;
+    std::size_t num_entities = 5000, num_labels = 4;
+    std::vector<std::vector<std::size_t>> model(num_entities+1);
+    // bulk load: long runs of the same labels
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        std::size_t label = 1 + (gv/700) % num_labels;
+        if(gv % 1000 > 990)
+            label = 1 + gv % num_labels;
+        glc.addLabel(gv, label);
+        model[gv].push_back(label);
+    }
+    std::size_t mem = glc.memory();
+    std::size_t nintervals = glc.compact(16);
+    out << "Intervals = " << nintervals << " memory [kB] " << mem/1000 << " --> " << glc.memory()/1000 << std::endl;
+    if(!nintervals || glc.memory() >= mem || glc.size() != num_entities || !check_labels(glc, model, num_labels))
+        return 0;
+    
+    // entities leave and join the intervals
+    std::srand(5);
+    for(std::size_t step = 0; step < 3000; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % num_entities;
+        std::size_t label = 1 + std::rand() % num_labels;
+        std::vector<std::size_t> &labels = model[gv];
+        auto it = std::lower_bound(labels.begin(), labels.end(), label);
+        if(it != labels.end() && *it == label)
+        {
+            glc.delLabel(gv, label);
+            labels.erase(it);
+        }
+        else
+        {
+            glc.addLabel(gv, label);
+            labels.insert(it, label);
+        }
+        if(step == 1500)
+            glc.compact(4);
+    }
+    if(!check_labels(glc, model, num_labels))
+        return 0;
+    
+    std::stringstream ss;
+    glc.write(ss);
+    glc.read(ss);
+    if(!check_labels(glc, model, num_labels))
+        return 0;
+    glc.expand();
+    if(!check_labels(glc, model, num_labels))
+        return 0;
+
+    // a stream written before the format marker: no header and no interval directory
+    SingleDLS dls, legacy;
+    for(std::size_t gv = 1; gv <= 100; ++gv)
+        dls.insert(gv, 1 + gv % 3);
+    std::stringstream current;
+    dls.write(current);
+    std::string bytes = current.str();
+    std::size_t word = sizeof(std::size_t), marker = 12345;
+    std::stringstream old;
+    old.write(bytes.data() + 2*word, bytes.size() - 3*word);
+    old.write((char*)&marker, word);
+    legacy.read(old);
+    old.read((char*)&marker, word);
+    if(!old || marker != 12345 || legacy.size_items() != 100)
+        return 0;
+    for(std::size_t gv = 1; gv <= 100; ++gv)
+    {
+        if(legacy.get_label(gv) != 1 + gv % 3)
+            return 0;
+    }
+    return legacy.count(2) == dls.count(2);
+}
+
+int test_label_bitmaps(std::ostream &out)
+{
+    // set algebra against the std merge algorithms; sparse and dense chunks
+    std::srand(3);
+    std::vector<std::size_t> a, b, ids, trusted;
+    for(std::size_t i = 0; i < 200000; ++i)
+    {
+        std::size_t id = (std::rand() % 2) ? std::rand() % 300000 : 1000000 + std::rand() % 10000000;
+        (i % 3 ? a : b).push_back(id);
+    }
+    LabelBitmap ba(a), bb(b);
+    bb.addRange(70000, 140000);
+    for(std::size_t id = 70000; id <= 140000; ++id)
+        b.push_back(id);
+    std::sort(a.begin(), a.end());
+    a.erase(std::unique(a.begin(), a.end()), a.end());
+    std::sort(b.begin(), b.end());
+    b.erase(std::unique(b.begin(), b.end()), b.end());
+    ba.getIds(ids);
+    if(ids != a || bb.cardinality() != b.size())
+        return 0;
+    
+    LabelBitmap r = ba;
+    r.andWith(bb).getIds(ids);
+    trusted.clear();
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(trusted));
+    if(ids != trusted || ba.andCardinality(bb) != trusted.size())
+        return 0;
+    r = ba;
+    r.orWith(bb).getIds(ids);
+    trusted.clear();
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(trusted));
+    if(ids != trusted)
+        return 0;
+    // bulk adds of unsorted ids (newest first, as the chains come) into existing chunks
+    LabelBitmap bulk = bb;
+    bulk.add(std::vector<std::size_t>(a.rbegin(), a.rend()));
+    bulk.add(std::vector<std::size_t>(a.rbegin(), a.rbegin() + 100));
+    if(bulk != r)
+        return 0;
+    r = ba;
+    r.andNotWith(bb).getIds(ids);
+    trusted.clear();
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(trusted));
+    if(ids != trusted)
+        return 0;
+    for(auto id : trusted)
+        r.remove(id);
+    if(!r.empty())
+        return 0;
+    
+    // label results as bitmaps
+    GraphLabelContainer glc;
+    for(std::size_t gv = 1; gv <= 100000; ++gv)
+    {
+        glc.addLabel(gv, 1 + gv % 3);
+        if(gv % 7 == 0)
+            glc.addLabel(gv, 4);
+    }
+    glc.compact(2);
+    for(std::size_t label = 1; label <= 4; ++label)
+    {
+        LabelBitmap ents;
+        glc.getEntities(label, ents, label == 4);
+        glc.getEntities(label, a);
+        std::sort(a.begin(), a.end());
+        ents.getIds(ids);
+        if(ids != a)
+            return 0;
+    }
+    // cached bitmap follows the changes
+    glc.addLabel(100001, 4);
+    glc.delLabel(7, 4);
+    LabelBitmap ents, frontier(std::vector<std::size_t>({7, 14, 15, 100001}));
+    glc.getEntities(4, ents, true);
+    ents.andWith(frontier).getIds(ids);
+    out << "label 4 in frontier: " << ids.size() << std::endl;
+    if(ids != std::vector<std::size_t>({14, 100001}))
+        return 0;
+    // concurrent readers fill and read the cache
+    glc.delLabel(14, 4);
+    std::vector<LabelBitmap> results(4);
+    std::vector<std::thread> readers;
+    for(std::size_t t = 0; t < results.size(); ++t)
+        readers.emplace_back([&glc, &results, t]() { glc.getEntities((t % 2) ? 3 : 4, results[t], true); });
+    for(auto &reader : readers)
+        reader.join();
+    glc.getEntities(4, ents);
+    return results[0] == ents && results[2] == ents;
+}
+
+int test_batch_labels(std::ostream &out)
+{
+    std::size_t num_entities = 20000, num_labels = 5;
+    GraphLabelContainer single, batch;
+    std::vector<std::vector<std::size_t>> model(num_entities+1);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        std::size_t label = 1 + (gv/1000) % 2;
+        single.addLabel(gv, label);
+        batch.addLabel(gv, label);
+        model[gv].push_back(label);
+    }
+    batch.compact(100);
+    
+    std::srand(17);
+    double tsingle = 0, tbatch = 0;
+    for(std::size_t round = 0; round < 20; ++round)
+    {
+        std::size_t label = 1 + std::rand() % num_labels;
+        bool del = (round % 3 == 2);
+        std::vector<std::size_t> gvs;
+        for(std::size_t i = 0; i < num_entities/4; ++i)
+            gvs.push_back(1 + std::rand() % num_entities);
+        
+        clock_t t0 = clock();
+        for(auto gv : gvs)
+        {
+            if(!del)
+                single.addLabel(gv, label);
+            else if(single.hasLabel(gv, label))
+                single.delLabel(gv, label);
+        }
+        clock_t t1 = clock();
+        if(del)
+            batch.delLabel(gvs, label);
+        else
+            batch.addLabel(gvs, label);
+        clock_t t2 = clock();
+        tsingle += double(t1-t0)/CLOCKS_PER_SEC;
+        tbatch += double(t2-t1)/CLOCKS_PER_SEC;
+        
+        for(auto gv : gvs)
+        {
+            std::vector<std::size_t> &labels = model[gv];
+            auto it = std::lower_bound(labels.begin(), labels.end(), label);
+            bool exists = (it != labels.end() && *it == label);
+            if(del && exists)
+                labels.erase(it);
+            else if(!del && !exists)
+                labels.insert(it, label);
+        }
+    }
+    out << "single [s] = " << tsingle << " batch [s] = " << tbatch << std::endl;
+    if(!check_labels(single, model, num_labels) || !check_labels(batch, model, num_labels))
+        return 0;
+    
+    // removing a label from all entities goes through the batch
+    batch.delLabel(3);
+    std::vector<std::size_t> ents;
+    return !batch.getEntities(3, ents) && batch.getEntities(4, ents);
+}
+
+int test_sorted_set_kernels(std::ostream &out)
+{
+    std::srand(23);
+    // correctness on random sizes/overlaps against the std merge algorithms, for every kernel width the CPU supports
+    if(SortedSets::useWidth(3))
+        return 0;
+    for(std::size_t width : {1, 2, 4})
+    {
+        if(!SortedSets::useWidth(width))
+            continue;
+        out << "checked the " << SortedSets::isa() << " kernels" << std::endl;
+        for(std::size_t round = 0; round < 500; ++round)
+        {
+            std::vector<std::size_t> a, b, r, trusted;
+            std::size_t range = 1 + std::rand() % 200;
+            for(std::size_t i = std::rand() % 60; i > 0; --i)
+                a.push_back(std::rand() % range);
+            for(std::size_t i = std::rand() % 60; i > 0; --i)
+                b.push_back(std::rand() % range);
+            if(round % 5 == 0)
+                b.insert(b.end(), a.begin(), a.end());
+            for(auto v : {&a, &b})
+            {
+                std::sort(v->begin(), v->end());
+                v->erase(std::unique(v->begin(), v->end()), v->end());
+            }
+            SortedSets::intersect(a, b, r);
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(trusted));
+            if(r != trusted)
+                return 0;
+            trusted.clear();
+            SortedSets::subtract(a, b, r);
+            std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(trusted));
+            if(r != trusted)
+                return 0;
+            trusted.clear();
+            SortedSets::unite(a, b, r);
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(trusted));
+            if(r != trusted)
+                return 0;
+            if(SortedSets::isSubset(a, b) != std::includes(b.begin(), b.end(), a.begin(), a.end()))
+                return 0;
+            std::size_t id = std::rand() % range;
+            if(SortedSets::contains(a, id) != std::binary_search(a.begin(), a.end(), id))
+                return 0;
+        }
+    }
+    SortedSets::useWidth(0);
+    
+    // microbenchmarks
+    std::vector<std::size_t> a, b, r;
+    for(std::size_t i = 0, x = 0, y = 0; i < 1000000; ++i)
+    {
+        a.push_back(x += 1 + std::rand() % 10);
+        b.push_back(y += 1 + std::rand() % 10);
+    }
+    std::size_t reps = 20, total = 0;
+    clock_t t0 = clock();
+    for(std::size_t i = 0; i < reps; ++i)
+        total += SortedSets::intersect(a, b, r);
+    clock_t t1 = clock();
+    for(std::size_t i = 0; i < reps; ++i)
+    {
+        r.clear();
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(r));
+        total -= r.size();
+    }
+    clock_t t2 = clock();
+    for(std::size_t i = 0; i < reps; ++i)
+        total += SortedSets::subtract(a, b, r);
+    clock_t t3 = clock();
+    for(std::size_t i = 0; i < reps; ++i)
+    {
+        r.clear();
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(r));
+        total -= r.size();
+    }
+    clock_t t4 = clock();
+    std::vector<std::size_t> labels = {2, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}, sub = {5, 13, 31};
+    std::size_t hits = 0, trusted_hits = 0;
+    for(std::size_t i = 0; i < 1000000; ++i)
+    {
+        sub[1] = 13 + (i & 1);
+        hits += SortedSets::isSubset(sub, labels) + SortedSets::contains(labels, i & 63);
+    }
+    clock_t t5 = clock();
+    for(std::size_t i = 0; i < 1000000; ++i)
+    {
+        sub[1] = 13 + (i & 1);
+        trusted_hits += std::includes(labels.begin(), labels.end(), sub.begin(), sub.end()) + 
+                        std::binary_search(labels.begin(), labels.end(), i & 63);
+    }
+    clock_t t6 = clock();
+    out << "SortedSets kernels (" << SortedSets::isa() << ") [ms]: intersect " << 1000.0*(t1-t0)/CLOCKS_PER_SEC/reps
+        << " vs std " << 1000.0*(t2-t1)/CLOCKS_PER_SEC/reps
+        << ", subtract " << 1000.0*(t3-t2)/CLOCKS_PER_SEC/reps
+        << " vs std " << 1000.0*(t4-t3)/CLOCKS_PER_SEC/reps
+        << ", 1M subset+contains on labels sets " << 1000.0*(t5-t4)/CLOCKS_PER_SEC
+        << " vs std " << 1000.0*(t6-t5)/CLOCKS_PER_SEC << std::endl;
+    return total == 0 && hits == trusted_hits;
+}
+
+int test_standing_queries(std::ostream &out)
+{
+    GraphLabelContainer glc;
+    std::size_t num_entities = 3000, num_labels = 6;
+    std::vector<std::vector<std::size_t>> model(num_entities+1);
+    std::srand(29);
+    for(std::size_t gv = 1; gv <= num_entities/2; ++gv)
+    {
+        std::size_t label = 1 + std::rand() % num_labels;
+        glc.addLabel(gv, label);
+        model[gv].push_back(label);
+    }
+    // fraud=1, cleared=2, watchlist=3
+    LabelExpression fraud = LabelExpression::label(1), cleared = LabelExpression::label(2);
+    LabelExpression expr = (fraud & !cleared) | LabelExpression::label(3);
+    expr.print(out);
+    std::size_t query = glc.registerQuery(expr);
+    std::size_t pushed = 0;
+    std::size_t query2 = glc.registerQuery(!LabelExpression::label(4), 
+                                           [&pushed](std::size_t, const std::vector<LabelQueryDelta> &deltas) { pushed += deltas.size(); });
+    
+    // the drained deltas applied on the initial result have to give the current result
+    std::vector<std::size_t> ids;
+    glc.getQueryResult(query).getIds(ids);
+    std::set<std::size_t> replay(ids.begin(), ids.end());
+    std::vector<LabelQueryDelta> deltas;
+    for(std::size_t step = 0; step < 20000; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % num_entities;
+        std::size_t label = 1 + std::rand() % num_labels;
+        std::vector<std::size_t> &labels = model[gv];
+        auto it = std::lower_bound(labels.begin(), labels.end(), label);
+        if(step % 1000 == 999)
+        {
+            std::vector<std::size_t> gvs;
+            for(std::size_t i = 0; i < 200; ++i)
+                gvs.push_back(1 + std::rand() % num_entities);
+            glc.addLabel(gvs, label);
+            for(auto g : gvs)
+            {
+                auto pos = std::lower_bound(model[g].begin(), model[g].end(), label);
+                if(pos == model[g].end() || *pos != label)
+                    model[g].insert(pos, label);
+            }
+        }
+        else if(step % 777 == 0)
+        {
+            glc.removeEntityFromLabels(gv);
+            labels.clear();
+        }
+        else if(it != labels.end() && *it == label)
+        {
+            glc.delLabel(gv, label);
+            labels.erase(it);
+        }
+        else
+        {
+            glc.addLabel(gv, label);
+            labels.insert(it, label);
+        }
+        if(step % 500 == 0)
+        {
+            glc.drainQuery(query, deltas);
+            for(auto &delta : deltas)
+            {
+                if(delta.entered)
+                    replay.insert(delta.gv);
+                else
+                    replay.erase(delta.gv);
+            }
+            glc.flushQueries();
+        }
+        if(step == 10000)
+            glc.compact(2);
+    }
+    glc.drainQuery(query, deltas);
+    for(auto &delta : deltas)
+    {
+        if(delta.entered)
+            replay.insert(delta.gv);
+        else
+            replay.erase(delta.gv);
+    }
+    glc.flushQueries();
+    
+    std::vector<std::size_t> trusted, trusted2;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        if(model[gv].empty())
+            continue;
+        if(expr.evaluate(model[gv]))
+            trusted.push_back(gv);
+        if(!std::binary_search(model[gv].begin(), model[gv].end(), 4))
+            trusted2.push_back(gv);
+    }
+    glc.getQueryResult(query).getIds(ids);
+    out << "query matches " << glc.getQueryCount(query) << " pushed deltas " << pushed << std::endl;
+    if(ids != trusted || glc.getQueryCount(query) != trusted.size() || std::vector<std::size_t>(replay.begin(), replay.end()) != trusted)
+        return 0;
+    glc.getQueryResult(query2).getIds(ids);
+    if(ids != trusted2 || !pushed)
+        return 0;
+    
+    // results follow the renumbering and a reload
+    std::vector<std::size_t> perm;
+    glc.renumber(perm);
+    std::stringstream ss;
+    glc.write(ss);
+    glc.read(ss);
+    std::vector<std::size_t> renumbered;
+    for(auto gv : trusted)
+        renumbered.push_back(perm[gv]);
+    std::sort(renumbered.begin(), renumbered.end());
+    glc.getQueryResult(query).getIds(ids);
+    if(ids != renumbered)
+        return 0;
+
+    // empty operands give an empty expression, which is rejected
+    LabelExpression none;
+    LabelExpression bad = (none & LabelExpression::label(1)) | !none;
+    return bad.empty() && (LabelExpression::label(1) | none).empty() && glc.registerQuery(bad) == std::size_t(-1) &&
+           !glc.getQueryCount(std::size_t(-1));
+}
+
+int test_label_ingest(std::ostream &out)
+{
+    // vertexes(id,label) table; small chunks so that the rows are cut across the blocks
+    std::size_t num_rows = 200000, num_names = 20000, num_labels = 12;
+    std::stringstream table;
+    table << "id,label\r\n";
+    std::srand(31);
+    std::vector<std::pair<std::string, std::string>> rows;
+    for(std::size_t row = 0; row < num_rows; ++row)
+    {
+        rows.push_back(std::make_pair("v" + std::to_string(std::rand() % num_names), "L" + std::to_string(std::rand() % num_labels)));
+        table << rows.back().first << "," << rows.back().second << (row % 3 ? "\n" : "\r\n");
+        if(row % 10000 == 0)
+            table << "bad_row\n\n";
+    }
+    GraphLabelContainer glc;
+    LabelIngest::Options options;
+    options.header = true;
+    options.chunk_size = 4096;
+    LabelIngest ingest(glc, options);
+    if(ingest.load(table) != num_rows || ingest.getStats().skipped != num_rows/10000)
+        return 0;
+    ingest.getStats().print(out);
+    
+    std::vector<std::vector<std::size_t>> model(ingest.getEntityNames().size());
+    for(auto &row : rows)
+    {
+        std::vector<std::size_t> &labels = model[ingest.entity(row.first)];
+        std::size_t label = ingest.label(row.second);
+        auto it = std::lower_bound(labels.begin(), labels.end(), label);
+        if(it == labels.end() || *it != label)
+            labels.insert(it, label);
+    }
+    if(ingest.getEntityNames().size() != model.size() || ingest.getLabelNames().size() != num_labels+1 || 
+       !check_labels(glc, model, num_labels))
+        return 0;
+    
+    // edges(id,source_name,target_name,label) with another delimiter, default chunks and no line end at the end
+    std::stringstream edges;
+    edges << "e1|kaan|eli|reports\ne2|eli|nima|reports\ne1|kaan|eli|knows\ne3|nima|steve";
+    GraphLabelContainer glc2;
+    options = LabelIngest::Options();
+    options.delimiter = '|';
+    options.label_column = 3;
+    LabelIngest ingest2(glc2, options);
+    std::vector<std::size_t> labels;
+    glc2.getLabels(ingest2.entity("e1"), labels);
+    if(ingest2.load(edges) != 3 || ingest2.getStats().skipped != 1)
+        return 0;
+    glc2.getLabels(ingest2.entity("e1"), labels);
+    if(labels.size() != 2 || glc2.size() != 2)
+        return 0;
+
+    // quoted fields; malformed quotes are skipped
+    std::stringstream quoted;
+    quoted << "\"v1\",\"a,b\"\nv2,\"say \"\"hi\"\"\"\nv3,\"open\nv4,x\"y\nv5,\"q\"z\n";
+    GraphLabelContainer glc3;
+    LabelIngest ingest3(glc3);
+    if(ingest3.load(quoted) != 2 || ingest3.getStats().skipped != 3 || ingest3.getLabelNames().size() != 3 ||
+       ingest3.getLabelNames()[1] != "a,b" || ingest3.getLabelNames()[2] != "say \"hi\"" || ingest3.getEntityNames()[1] != "v1")
+        return 0;
+
+    // a failing stage: the stages are joined and the exception reaches the caller
+    struct FailingBuffer : public std::streambuf
+    {
+        std::string data;
+        bool served = false;
+        int_type underflow()
+        {
+            if(served)
+                throw std::runtime_error("read error");
+            served = true;
+            setg(&data[0], &data[0], &data[0] + data.size());
+            return traits_type::to_int_type(data[0]);
+        }
+    } buffer;
+    buffer.data = std::string(10000, 'x') + ",L\n";
+    std::istream failing(&buffer);
+    failing.exceptions(std::ios::badbit);
+    options = LabelIngest::Options();
+    options.chunk_size = 64;
+    LabelIngest ingest4(glc3, options);
+    bool failed = false;
+    try
+    {
+        ingest4.load(failing);
+    }
+    catch(const std::exception &e)
+    {
+        out << "load failed: " << e.what() << std::endl;
+        failed = true;
+    }
+    if(!failed)
+        return 0;
+
+    // a failing consumer: the reader stops at the next block instead of reading the input to its end
+    struct EndlessBuffer : public std::streambuf
+    {
+        std::string data;
+        std::size_t reads = 0;
+        int_type underflow()
+        {
+            if(++reads > 100000)
+                return traits_type::eof();
+            setg(&data[0], &data[0], &data[0] + data.size());
+            return traits_type::to_int_type(data[0]);
+        }
+    } endless;
+    endless.data = "v,L\n";
+    std::istream unbounded(&endless);
+    GraphLabelContainer glc5;
+    glc5.addMoveListener([](const std::size_t*, std::size_t, std::size_t, std::size_t) { throw std::runtime_error("consumer error"); });
+    options.queue_depth = 1;
+    LabelIngest ingest5(glc5, options);
+    try
+    {
+        ingest5.load(unbounded);
+    }
+    catch(const std::exception &e)
+    {
+        out << "load failed: " << e.what() << " after " << endless.reads << " reads" << std::endl;
+        return endless.reads < 1000;
+    }
+    return 0;
+}
+
+int test_chunked_file(std::ostream &out)
+{
+    GraphLabelContainer glc;
+    std::size_t num_entities = 100000, num_labels = 10;
+    std::vector<std::vector<std::size_t>> model(num_entities+1);
+    std::srand(37);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        // runs of the same labels with some scattered entities
+        std::size_t label = (std::rand() % 10) ? 1 + (gv/5000) % num_labels : 1 + std::rand() % num_labels;
+        glc.addLabel(gv, label);
+        model[gv].push_back(label);
+        if(gv % 7 == 0)
+        {
+            std::size_t other = 1 + std::rand() % num_labels;
+            glc.addLabel(gv, other);
+            if(other != label)
+                model[gv].insert(std::lower_bound(model[gv].begin(), model[gv].end(), other), other);
+        }
+    }
+    for(std::size_t gv = 1; gv <= num_entities; gv += 101)
+    {
+        glc.removeEntityFromLabels(gv);
+        model[gv].clear();
+    }
+    glc.compact(256);
+    
+    const char *filename = "test_labels.glcf";
+    LabelFile::Options options;
+    options.block_items = 4096;
+    options.num_threads = 4;
+    std::vector<std::size_t> file_sizes;
+    for(bool compress : {false, true})
+    {
+        options.compress = compress;
+        if(!glc.writeFile(filename, options))
+            return 0;
+        LabelFile file;
+        if(!file.open(filename) || file.size_items() != num_entities || file.getBlocks().size() != (num_entities+4095)/4096)
+            return 0;
+        std::size_t bytes = 0;
+        for(auto &block : file.getBlocks())
+            bytes += block.size;
+        file_sizes.push_back(bytes);
+        
+        GraphLabelContainer glc2;
+        if(!glc2.readFile(filename, 4) || !check_labels(glc2, model, num_labels))
+            return 0;
+        std::vector<std::size_t> ents, ents2;
+        glc.getEntities({1, 2}, ents);
+        glc2.getEntities({1, 2}, ents2);
+        std::sort(ents.begin(), ents.end());
+        std::sort(ents2.begin(), ents2.end());
+        if(ents != ents2 || glc2.next_index() != glc.next_index())
+            return 0;
+        // still modifiable
+        glc2.addLabel(num_entities+1, 3);
+        glc2.delLabel(2, model[2].empty() ? 1 : model[2][0]);
+    }
+    out << "chunked file blocks bytes raw " << file_sizes[0] << " encoded " << file_sizes[1] << std::endl;
+    if(file_sizes[1]*4 >= file_sizes[0])
+        return 0;
+    
+    // partial load
+    std::vector<std::size_t> pair_indexes;
+    std::vector<std::vector<std::size_t>> index2labels;
+    if(!GraphLabelContainer::readRange(filename, 5000, 13000, pair_indexes, index2labels) || pair_indexes.size() != 8001)
+        return 0;
+    for(std::size_t gv = 5000; gv <= 13000; ++gv)
+    {
+        std::size_t pair_index = pair_indexes[gv-5000];
+        if((pair_index ? index2labels[pair_index] : std::vector<std::size_t>()) != model[gv])
+            return 0;
+    }
+    
+    // corruption is detected
+    {
+        std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(20000);
+        f.put(char(0x5a) ^ char(f.peek()));
+    }
+    GraphLabelContainer glc3;
+    bool corrupt = !glc3.readFile(filename) && !glc3.size();
+    std::remove(filename);
+    return corrupt && !glc3.readFile(filename);
+}
+
+int test_label_sampling(std::ostream &out)
+{
+    // label 1 over three pair indexes, part of them in intervals
+    GraphLabelContainer glc;
+    std::size_t num_entities = 60;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        glc.addLabel(gv, 1);
+        if(gv > 20)
+            glc.addLabel(gv, gv % 3 ? 2 : 3);
+    }
+    glc.compact(8);
+    std::vector<std::size_t> all, ents, preview;
+    glc.getEntities(1, all);
+    if(glc.sampleEntities(1, 100, ents) != num_entities || glc.getFirstEntities(1, 25, preview) != 25 || 
+       !std::equal(preview.begin(), preview.end(), all.begin()))
+        return 0;
+    
+    // each entity is drawn 1000 times in expectation (sd ~ 29)
+    std::size_t k = 10, trials = 6000;
+    std::vector<std::size_t> hits(num_entities+1, 0);
+    for(std::size_t seed = 0; seed < trials; ++seed)
+    {
+        if(glc.sampleEntities(1, k, ents, seed) != k)
+            return 0;
+        std::sort(ents.begin(), ents.end());
+        if(std::unique(ents.begin(), ents.end()) != ents.end())
+            return 0;
+        for(auto gv : ents)
+            hits[gv]++;
+    }
+    auto minmax = std::minmax_element(hits.begin()+1, hits.end());
+    out << "sample hits per entity: " << *minmax.first << " - " << *minmax.second << std::endl;
+    if(*minmax.first < 850 || *minmax.second > 1150)
+        return 0;
+    
+    // a large label: the oldest and the newest halves of the chains are drawn alike
+    GraphLabelContainer big;
+    std::srand(41);
+    for(std::size_t gv = 1; gv <= 200000; ++gv)
+        big.addLabel(gv, 1 + std::rand() % 4);
+    if(big.sampleEntities(1, 1000, ents, 7) != 1000)
+        return 0;
+    std::size_t older = 0;
+    for(auto gv : ents)
+    {
+        if(!big.hasLabel(gv, 1))
+            return 0;
+        older += gv <= 100000;
+    }
+    out << "sampled entities of the older half: " << older << std::endl;
+    std::sort(ents.begin(), ents.end());
+    if(std::unique(ents.begin(), ents.end()) != ents.end() || older < 400 || older > 600)
+        return 0;
+    if(big.getFirstEntities(1, 1000, preview) != 1000 || big.sampleEntities(5, 10, ents) != 0)
+        return 0;
+    
+    // the fast mode draws the same entities after moves, deletions, compaction and renumbering
+    std::vector<std::size_t> fast;
+    auto same_draws = [&](const GraphLabelContainer &glc, std::size_t label)
+    {
+        for(std::size_t seed = 0; seed < 20; ++seed)
+        {
+            if(glc.sampleEntities(label, 500, ents, seed) != glc.sampleEntities(label, 500, fast, seed, false) || ents != fast)
+                return false;
+        }
+        return true;
+    };
+    if(!same_draws(glc, 1) || !same_draws(big, 1))
+        return 0;
+    for(std::size_t i = 0; i < 30000; ++i)
+    {
+        std::size_t gv = 1 + std::rand() % 200000, label = 1 + std::rand() % 4;
+        if(i % 3)
+            big.addLabel(gv, label);
+        else if(big.hasLabel(gv, label))
+            big.delLabel(gv, label);
+    }
+    std::vector<std::size_t> batch;
+    for(std::size_t gv = 1000; gv < 60000; gv += 1 + std::rand() % 5)
+    {
+        if(big.hasLabel(gv, 1) && !big.hasLabel(gv, 2))
+            batch.push_back(gv);
+    }
+    big.addLabel(batch, 2);
+    big.delLabel(batch, 1);
+    if(!same_draws(big, 1) || !same_draws(big, 2))
+        return 0;
+    big.compact(4);
+    if(!same_draws(big, 1) || !same_draws(big, 3))
+        return 0;
+    
+    // SingleDLS: selecting all positions from the skip points gives the chain order
+    SingleDLS dls;
+    for(std::size_t item = 1; item <= 5000; ++item)
+        dls.insert(item, 1 + std::rand() % 3);
+    std::vector<std::size_t> items, moved;
+    for(std::size_t i = 0; i < 2000; ++i)
+    {
+        std::size_t item = 1 + std::rand() % 5000;
+        if(i % 4)
+            dls.insert(item, 1 + std::rand() % 3);
+        else
+            dls.del_item(item);
+    }
+    for(std::size_t item = 1; item <= 5000; item += 2)
+    {
+        if(dls.get_label(item) == 2)
+            moved.push_back(item);
+    }
+    dls.move(moved, 2, 3);
+    for(std::size_t label = 1; label <= 3; ++label)
+    {
+        std::vector<std::size_t> positions(dls.count(label));
+        std::iota(positions.begin(), positions.end(), 0);
+        dls.get(label, all);
+        items.clear();
+        dls.select(label, positions, items, true);
+        if(items != all)
+            return 0;
+    }
+    
+    // a posting label is sampled and previewed from its bitmap
+    GraphLabelContainer posted;
+    for(std::size_t gv = 1; gv <= 70000; gv += 2)
+        posted.addLabel(gv, gv % 3 ? 1 : 2);
+    for(std::size_t gv = 1; gv <= 100; ++gv)
+        posted.addLabel(gv, 3);
+    posted.setPostingLabel(1, true);
+    posted.setPostingLabel(3, true);
+    posted.getEntities(1, all);
+    std::vector<std::size_t> positions = {0, 1, 5000, 23000, all.size()-1};
+    LabelBitmap bitmap;
+    posted.getEntities(1, bitmap);
+    items.clear();
+    if(bitmap.select(positions, items) != positions.size())
+        return 0;
+    for(std::size_t i = 0; i < positions.size(); ++i)
+    {
+        if(items[i] != all[positions[i]])
+            return 0;
+    }
+    if(posted.getFirstEntities(1, 1000, preview) != 1000 || !std::equal(preview.begin(), preview.end(), all.begin()) ||
+       posted.sampleEntities(1, 1000, ents, 3) != 1000)
+        return 0;
+    for(auto gv : ents)
+    {
+        if(!posted.hasLabel(gv, 1))
+            return 0;
+    }
+    hits.assign(101, 0);
+    for(std::size_t seed = 0; seed < 6000; ++seed)
+    {
+        if(posted.sampleEntities(3, 10, ents, seed, false) != 10)
+            return 0;
+        for(auto gv : ents)
+            hits[gv]++;
+    }
+    minmax = std::minmax_element(hits.begin()+1, hits.end());
+    out << "posting sample hits per entity: " << *minmax.first << " - " << *minmax.second << std::endl;
+    return *minmax.first >= 480 && *minmax.second <= 720;
+}
+
+// (src index, edge index, dst index, count) of the edges recomputed from the containers
+std::vector<std::size_t> brute_triples(const GraphLabelContainer &nodes, const GraphLabelContainer &edges, 
+                                       const std::map<std::size_t, std::pair<std::size_t, std::size_t>> &ends)
+{
+    std::map<std::vector<std::size_t>, std::size_t> counts;
+    for(auto &it : ends)
+        counts[{nodes.getPairIndex(it.second.first), edges.getPairIndex(it.first), nodes.getPairIndex(it.second.second)}]++;
+    std::vector<std::size_t> triples;
+    for(auto &it : counts)
+    {
+        triples.insert(triples.end(), it.first.begin(), it.first.end());
+        triples.push_back(it.second);
+    }
+    return triples;
+}
+
+int test_label_path_index(std::ostream &out)
+{
+    // node labels: person=1, ceo=2 (is-a person), company=3, city=4; edge labels: knows=1, works_at=2, located_in=3
+    GraphLabelContainer nodes, edges;
+    nodes.addIsA(2, 1);
+    LabelPathIndex index(nodes, edges);
+    std::size_t num_persons = 300, num_companies = 20, num_cities = 5;
+    std::map<std::size_t, std::pair<std::size_t, std::size_t>> ends;
+    std::size_t next_edge = 1;
+    std::srand(43);
+    auto connect = [&](std::size_t src, std::size_t dst, std::size_t label)
+    {
+        index.addEdge(next_edge, src, dst);
+        edges.addLabel(next_edge, label);
+        ends[next_edge++] = std::make_pair(src, dst);
+    };
+    for(std::size_t gv = 1; gv <= num_persons; ++gv)
+        nodes.addLabel(gv, gv % 50 ? 1 : 2);
+    for(std::size_t gv = num_persons+1; gv <= num_persons+num_companies; ++gv)
+        nodes.addLabel(gv, 3);
+    for(std::size_t gv = num_persons+num_companies+1; gv <= num_persons+num_companies+num_cities; ++gv)
+        nodes.addLabel(gv, 4);
+    for(std::size_t i = 0; i < 1000; ++i)
+        connect(1 + std::rand() % num_persons, 1 + std::rand() % num_persons, 1);
+    for(std::size_t gv = 1; gv <= num_persons; ++gv)
+        connect(gv, num_persons + 1 + std::rand() % num_companies, 2);
+    for(std::size_t gv = num_persons+1; gv <= num_persons+num_companies; ++gv)
+        connect(gv, num_persons + num_companies + 1 + std::rand() % num_cities, 3);
+    
+    std::vector<std::size_t> triples;
+    index.getTriples(triples);
+    out << "schema triples " << index.size() << " for " << ends.size() << " edges" << std::endl;
+    if(triples != brute_triples(nodes, edges, ends))
+        return 0;
+    
+    std::vector<std::vector<std::size_t>> node_indexes, edge_indexes;
+    std::size_t hops = 0;
+    if(!index.prunePath(1, {2, 3}, 4, node_indexes, edge_indexes) || node_indexes[1] != std::vector<std::size_t>{nodes.getPairIndex(num_persons+1)} ||
+       edge_indexes[1] != std::vector<std::size_t>{edges.getPairIndex(ends.rbegin()->first)})
+        return 0;
+    if(!index.isReachable(2, {1, 2}, 3) || index.isReachable(4, {3}, 3) || index.isReachable(1, {3}, 4) || index.isReachable(1, {1, 1, 3}, 0))
+        return 0;
+    if(!index.isReachableWithin(1, 4, 3, 0, &hops) || hops != 2 || index.isReachableWithin(1, 4, 1) || index.isReachableWithin(4, 1, 5) || 
+       index.isReachableWithin(1, 4, 5, 1))
+        return 0;
+    
+    // the index follows the label changes of both containers
+    for(std::size_t step = 0; step < 3000; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % (num_persons + num_companies + num_cities);
+        std::size_t edge = 1 + std::rand() % (next_edge-1);
+        switch(step % 6)
+        {
+            case 0: nodes.addLabel(gv, 1 + std::rand() % 6); break;
+            case 1:
+                if(nodes.hasLabel(gv, 1 + step % 5))
+                    nodes.delLabel(gv, 1 + step % 5);
+                break;
+            case 2: edges.addLabel(edge, 1 + std::rand() % 4); break;
+            case 3:
+                if(edges.hasLabel(edge, 1 + step % 4))
+                    edges.delLabel(edge, 1 + step % 4);
+                break;
+            case 4:
+                if(index.removeEdge(edge))
+                    ends.erase(edge);
+                break;
+            default:
+                {
+                    std::vector<std::size_t> gvs;
+                    for(std::size_t i = 0; i < 20; ++i)
+                        gvs.push_back(1 + std::rand() % num_persons);
+                    nodes.addLabel(gvs, 5);
+                    connect(gv, 1 + std::rand() % num_persons, 1 + std::rand() % 4);
+                }
+        }
+    }
+    index.getTriples(triples);
+    if(triples != brute_triples(nodes, edges, ends))
+        return 0;
+    
+    // renumbered nodes and edges
+    std::vector<std::size_t> perm;
+    nodes.renumber(perm);
+    index.applyNodeRenumbering(perm);
+    for(auto &it : ends)
+        it.second = std::make_pair(perm[it.second.first], perm[it.second.second]);
+    edges.renumber(perm);
+    index.applyEdgeRenumbering(perm);
+    std::map<std::size_t, std::pair<std::size_t, std::size_t>> renumbered;
+    for(auto &it : ends)
+        renumbered[perm[it.first]] = it.second;
+    ends.swap(renumbered);
+    for(std::size_t step = 0; step < 500; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % num_persons;
+        if(nodes.hasLabel(gv, 1))
+            nodes.delLabel(gv, 1);
+        edges.addLabel(ends.begin()->first + std::rand() % 100, 3);
+    }
+    index.getTriples(triples);
+    if(triples != brute_triples(nodes, edges, ends))
+        return 0;
+    index.rebuild();
+    index.getTriples(triples);
+    if(triples != brute_triples(nodes, edges, ends))
+        return 0;
+    
+    // posting labels are not in the pair indexes: they match any of them and never prune a possible path
+    GraphLabelContainer posted_nodes, posted_edges;
+    LabelPathIndex posted(posted_nodes, posted_edges);
+    ends.clear();
+    for(std::size_t gv = 1; gv <= 10; ++gv)
+    {
+        posted_nodes.addLabel(gv, 1);
+        posted.addEdge(gv, gv, 11);
+        posted_edges.addLabel(gv, 3);
+        ends[gv] = std::make_pair(gv, std::size_t(11));
+    }
+    posted_nodes.addLabel(11, 4);
+    if(!posted_nodes.setPostingLabel(4, true) || !posted_edges.setPostingLabel(3, true))
+        return 0;
+    posted.getTriples(triples);
+    return triples == brute_triples(posted_nodes, posted_edges, ends) && posted.isReachable(1, {3}, 4) && 
+           posted.isReachableWithin(1, 4, 1) && !posted.isReachable(4, {3}, 1);
+}
+
+int test_label_delta(std::ostream &out)
+{
+    std::size_t num_entities = 20000, num_labels = 8;
+    std::vector<std::vector<std::size_t>> model(num_entities+1);
+    GraphLabelContainer a;
+    std::srand(47);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        for(std::size_t label = 1; label <= num_labels; ++label)
+        {
+            if(std::rand() % 4 == 0)
+            {
+                a.addLabel(gv, label);
+                model[gv].push_back(label);
+            }
+        }
+    }
+    a.compact(4);
+    std::stringstream image;
+    a.write(image);
+    
+    // b: a replica with some changes and fresh labels sets
+    GraphLabelContainer b;
+    image.seekg(0);
+    b.read(image);
+    for(std::size_t step = 0; step < 500; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % (num_entities + 100);
+        if(gv >= model.size())
+            model.resize(gv+1);
+        std::size_t label = 1 + std::rand() % (num_labels + 2);
+        if(step % 50 == 0)
+        {
+            b.removeEntityFromLabels(gv);
+            model[gv].clear();
+        }
+        else if(!std::binary_search(model[gv].begin(), model[gv].end(), label))
+        {
+            b.addLabel(gv, label);
+            model[gv].insert(std::lower_bound(model[gv].begin(), model[gv].end(), label), label);
+        }
+    }
+    // c: b's labels inserted in reverse so that the pair indexes are numbered differently
+    GraphLabelContainer c;
+    for(std::size_t gv = model.size()-1; gv > 0; --gv)
+    {
+        if(!model[gv].empty())
+            c.addLabel(gv, model[gv]);
+    }
+    
+    std::size_t trusted = 0;
+    for(std::size_t gv = 1; gv < model.size(); ++gv)
+    {
+        std::vector<std::size_t> labels;
+        a.getLabels(gv, labels);
+        trusted += (labels != model[gv]);
+    }
+    LabelDelta delta, delta2;
+    if(GraphLabelContainer::diff(a, b, delta) != trusted || GraphLabelContainer::diff(a, c, delta2) != trusted || delta.size() != trusted)
+        return 0;
+    std::stringstream ss;
+    delta.write(ss);
+    out << "delta of " << trusted << " entities: " << ss.str().size() << " bytes vs image " << image.str().size() << std::endl;
+    if(ss.str().size()*10 > image.str().size())
+        return 0;
+    delta.read(ss);
+    
+    GraphLabelContainer a2;
+    image.seekg(0);
+    a2.read(image);
+    if(a.apply(delta) != trusted || a2.apply(delta2) != trusted)
+        return 0;
+    if(!check_labels(a, model, num_labels+2) || !check_labels(a2, model, num_labels+2) || GraphLabelContainer::diff(a, c, delta) || 
+       GraphLabelContainer::diff(c, a2, delta))
+        return 0;
+    
+    // shard merge: an entity range of b into an empty container
+    GraphLabelContainer shard;
+    GraphLabelContainer::diff(shard, b, delta, 1000, 2999);
+    if(shard.apply(delta) != delta.size())
+        return 0;
+    std::vector<std::size_t> labels;
+    for(std::size_t gv = 1; gv < model.size(); ++gv)
+    {
+        shard.getLabels(gv, labels);
+        if(labels != ((gv >= 1000 && gv <= 2999) ? model[gv] : std::vector<std::size_t>()))
+            return 0;
+    }
+    // back to empty
+    GraphLabelContainer::diff(shard, GraphLabelContainer(), delta);
+    shard.apply(delta);
+    for(std::size_t gv = 1; gv < model.size(); ++gv)
+    {
+        if(shard.hasLabel(gv))
+            return 0;
+    }
+    return shard.getLabelCount(1) == 0;
+}
+
+int test_property_container(std::ostream &out)
+{
+    PropertyContainer props;
+    std::size_t status = props.addKey("status", PropertyContainer::STRING);
+    std::size_t region = props.addKey("region", PropertyContainer::STRING);
+    std::size_t risk = props.addKey("risk_score", PropertyContainer::NUMBER);
+    if(props.addKey("risk_score", PropertyContainer::STRING) || props.getKey("region") != region || props.setNumber(1, status, 3))
+        return 0;
+    const char *statuses[] = {"open", "closed", "pending"};
+    const char *regions[] = {"EU", "US", "APAC", "LATAM", "MEA"};
+    std::size_t num_entities = 50000;
+    std::vector<std::string> model_status(num_entities+1), model_region(num_entities+1);
+    std::vector<double> model_risk(num_entities+1, -1);
+    std::srand(53);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        model_status[gv] = statuses[std::rand() % 3];
+        model_region[gv] = regions[std::rand() % 5];
+        model_risk[gv] = std::rand() % 101;
+        props.setString(gv, status, model_status[gv]);
+        props.setString(gv, region, model_region[gv]);
+        props.setNumber(gv, risk, model_risk[gv]);
+    }
+    // updates replace the value of the key
+    for(std::size_t step = 0; step < 5000; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % num_entities;
+        if(step % 10 == 0)
+        {
+            props.delProperty(gv, risk);
+            model_risk[gv] = -1;
+        }
+        else
+        {
+            model_risk[gv] = std::rand() % 101;
+            props.setNumber(gv, risk, model_risk[gv]);
+        }
+    }
+    double value = 0;
+    std::string text;
+    std::size_t gv = 1 + std::rand() % num_entities;
+    if(props.getNumber(gv, risk, value) != (model_risk[gv] >= 0) || (model_risk[gv] >= 0 && value != model_risk[gv]) || 
+       !props.getString(gv, region, text) || text != model_region[gv] || props.getNumber(gv, region, value))
+        return 0;
+    props.print(gv, out);
+    
+    typedef PropertyContainer::Predicate P;
+    std::vector<std::vector<P>> queries = {
+        {P(risk, PropertyContainer::LE, 15)},
+        {P(status, PropertyContainer::EQ, std::string("open")), P(risk, PropertyContainer::GT, 90)},
+        {P(region, PropertyContainer::NE, std::string("EU")), P(risk, PropertyContainer::GE, 50), P(risk, PropertyContainer::LT, 52)},
+        {P(risk, PropertyContainer::EQ, 7), P(risk, PropertyContainer::NE, 7)},
+        {P(status, PropertyContainer::EQ, std::string("unknown"))}
+    };
+    auto satisfies = [&](std::size_t gv, const P &p)
+    {
+        if(p.key == risk)
+        {
+            double r = model_risk[gv];
+            if(r < 0)
+                return false;
+            switch(p.op)
+            {
+                case PropertyContainer::EQ: return r == p.number;
+                case PropertyContainer::NE: return r != p.number;
+                case PropertyContainer::LT: return r < p.number;
+                case PropertyContainer::LE: return r <= p.number;
+                case PropertyContainer::GT: return r > p.number;
+                default: return r >= p.number;
+            }
+        }
+        const std::string &v = (p.key == status) ? model_status[gv] : model_region[gv];
+        return (p.op == PropertyContainer::EQ) == (v == p.text);
+    };
+    std::vector<std::size_t> ents;
+    for(auto &query : queries)
+    {
+        std::vector<std::size_t> trusted;
+        for(std::size_t gv = 1; gv <= num_entities; ++gv)
+        {
+            bool all = true;
+            for(auto &p : query)
+                all = all && satisfies(gv, p);
+            if(all)
+                trusted.push_back(gv);
+        }
+        props.find(query, ents);
+        std::sort(ents.begin(), ents.end());
+        if(ents != trusted)
+            return 0;
+    }
+    // NaN is neither stored nor matched; no predicates select every entity with a property
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    if(props.setNumber(gv, risk, nan) || props.find(P(risk, PropertyContainer::EQ, nan), ents) || 
+       props.find(P(risk, PropertyContainer::NE, nan), ents) || props.find(std::vector<P>(), ents) != num_entities)
+        return 0;
+    // ordering predicates on a STRING key are rejected, not matched against nothing
+    if(props.isSupported(P(region, PropertyContainer::LT, std::string("EU"))) || !props.isSupported(P(region, PropertyContainer::NE, std::string("EU"))) ||
+       props.find({P(risk, PropertyContainer::LE, 15), P(region, PropertyContainer::GE, std::string("EU"))}, ents) != std::size_t(-1) || !ents.empty())
+        return 0;
+    out << "property container memory per entity: " << double(props.memory())/num_entities << " bytes" << std::endl;
+    props.removeEntity(gv);
+    if(props.find(std::vector<P>(), ents) != num_entities-1 || std::find(ents.begin(), ents.end(), gv) != ents.end())
+        return 0;
+    return !props.getString(gv, status, text) && props.memory() < num_entities*3*50;
+}
+
+int test_adaptive_tuples(std::ostream &out)
+{
+    GraphLabelContainer glc;
+    std::size_t num_entities = 20000, num_labels = 204;
+    std::vector<std::vector<std::size_t>> model(num_entities+1);
+    auto model_add = [&](std::size_t gv, std::size_t label)
+    {
+        auto it = std::lower_bound(model[gv].begin(), model[gv].end(), label);
+        if(it == model[gv].end() || *it != label)
+            model[gv].insert(it, label);
+    };
+    GraphLabelContainer::TuplePolicy policy;
+    policy.adaptive = true;
+    policy.max_ratio = 0.05;
+    glc.setTuplePolicy(policy);
+    // labels 1..4 are coarse, the others are spread independently --> almost every entity gets its own tuple
+    std::srand(59);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        model_add(gv, 1 + std::rand() % 4);
+        for(int i = 0; i < 3; ++i)
+            model_add(gv, 5 + std::rand() % (num_labels-4));
+        for(auto label : model[gv])
+            glc.addLabel(gv, label);
+    }
+    GraphLabelContainer::TupleStats stats = glc.getTupleStats();
+    out << "tuples " << stats.tuples << " ratio " << stats.ratio << " posting labels " << stats.posting_labels
+        << " posting entries " << stats.posting_entries << " memory " << glc.memory() << std::endl;
+    if(stats.ratio > policy.max_ratio || !stats.posting_labels || !check_labels(glc, model, num_labels))
+        return 0;
+    // updates through all the mutators
+    std::vector<std::size_t> gvs;
+    for(std::size_t step = 0; step < 3000; ++step)
+    {
+        std::size_t gv = 1 + std::rand() % num_entities, label = 1 + std::rand() % num_labels;
+        if(step % 3 == 0 && glc.hasLabel(gv, label))
+        {
+            glc.delLabel(gv, label);
+            model[gv].erase(std::lower_bound(model[gv].begin(), model[gv].end(), label));
+        }
+        else if(step % 3 == 1)
+        {
+            std::vector<std::size_t> labels = {std::size_t(1 + std::rand() % 4), label};
+            std::sort(labels.begin(), labels.end());
+            labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+            glc.setLabels(gv, labels);
+            model[gv] = labels;
+        }
+        else
+            gvs.push_back(gv);
+    }
+    glc.addLabel(gvs, 7);
+    for(auto gv : gvs)
+        model_add(gv, 7);
+    glc.removeEntityFromLabels(3);
+    model[3].clear();
+    if(!check_labels(glc, model, num_labels) || glc.hasLabel(3))
+        return 0;
+    // an entity whose only labels are posting labels
+    std::size_t posted = 0;
+    for(std::size_t l = 5; l <= num_labels && !posted; ++l)
+        posted = glc.isPosting(l) ? l : 0;
+    glc.setLabels(9, std::vector<std::size_t>{posted});
+    if(!glc.hasLabel(9) || glc.getPairIndex(9))
+        return 0;
+    glc.delLabel(std::vector<std::size_t>{9}, posted);
+    if(glc.hasLabel(9))
+        return 0;
+    glc.addLabel(9, posted);
+    glc.delLabel(9, posted);
+    glc.setLabels(9, model[9]);
+    if(glc.hasLabel(9) != !model[9].empty() || !check_labels(glc, model, num_labels))
+        return 0;
+    // exact labels sets span the tuples and the postings
+    std::vector<std::size_t> ents, trusted;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        if(model[gv] == model[5])
+            trusted.push_back(gv);
+    }
+    glc.getEntities(model[5], ents);
+    std::sort(ents.begin(), ents.end());
+    if(ents != trusted || !glc.isAssociated(model[5]))
+        return 0;
+    // samples of a posting label
+    std::size_t label = 0;
+    for(std::size_t l = 5; l <= num_labels && !label; ++l)
+        label = glc.isPosting(l) ? l : 0;
+    glc.sampleEntities(label, 10, ents, 7);
+    if(ents.size() != 10)
+        return 0;
+    for(auto gv : ents)
+    {
+        if(!std::binary_search(model[gv].begin(), model[gv].end(), label))
+            return 0;
+    }
+    // the subsumed entities of a posting label come from its posting
+    trusted.clear();
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        if(std::binary_search(model[gv].begin(), model[gv].end(), label))
+            trusted.push_back(gv);
+    }
+    LabelBitmap subsumed;
+    glc.getSubsumedEntities(label, ents);
+    std::sort(ents.begin(), ents.end());
+    if(ents != trusted || glc.getSubsumedEntities(label, subsumed) != trusted.size() || !glc.getSubsumedIndexes(label).empty())
+        return 0;
+    // the co-occurrence weights of the posting labels agree with the labels of the entities
+    std::map<std::pair<std::size_t, std::size_t>, std::size_t> pairs;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        for(std::size_t i = 0; i < model[gv].size(); ++i)
+        {
+            for(std::size_t j = i+1; j < model[gv].size(); ++j)
+                pairs[std::make_pair(model[gv][i], model[gv][j])]++;
+        }
+    }
+    std::vector<std::size_t> edges, brute;
+    for(auto &it : pairs)
+        brute.insert(brute.end(), {it.first.first, it.first.second, it.second});
+    if(glc.getCooccurrence(edges) != pairs.size() || edges != brute)
+        return 0;
+    // round trips and deltas
+    std::stringstream ss;
+    glc.write(ss);
+    GraphLabelContainer copy;
+    copy.read(ss);
+    const char *filename = "test_labels.glcf";
+    GraphLabelContainer loaded;
+    bool ok = glc.writeFile(filename) && loaded.readFile(filename, 2);
+    // a shard read without loading gets the posting labels of its entities too
+    std::vector<std::size_t> range_indexes;
+    std::vector<std::vector<std::size_t>> range_labels;
+    ok = ok && GraphLabelContainer::readRange(filename, 7000, 13000, range_indexes, range_labels, 2) && range_indexes.size() == 6001;
+    for(std::size_t i = 0; ok && i < range_indexes.size(); ++i)
+        ok = range_labels[range_indexes[i]] == model[7000+i];
+    std::remove(filename);
+    if(!ok || !copy.isPosting(label) || !check_labels(copy, model, num_labels) || !check_labels(loaded, model, num_labels))
+        return 0;
+    // the postings section is always written: a stream read back stops where it ends, even for an empty container
+    for(std::size_t postings = 0; postings < 2; ++postings)
+    {
+        GraphLabelContainer small, back;
+        if(postings)
+        {
+            small.setPostingLabel(3, true);
+            small.addLabel(7, 3);
+        }
+        std::stringstream chained;
+        std::size_t marker = 0x1234, read_marker = 0;
+        small.write(chained);
+        chained.write((char*)&marker, sizeof(std::size_t));
+        back.read(chained);
+        if(!chained.read((char*)&read_marker, sizeof(std::size_t)) || read_marker != marker || back.hasLabel(7, 3) != (postings == 1))
+            return 0;
+    }
+    // a stream written before the format marker (no header, no postings section) is read as such; a newer version fails
+    {
+        GraphLabelContainer tupled, back;
+        tupled.addLabel(5, 2);
+        tupled.addLabel(9, 4);
+        std::stringstream current;
+        tupled.write(current);
+        std::string bytes = current.str();
+        std::size_t word = sizeof(std::size_t), marker = 0x1234, read_marker = 0;
+        std::stringstream legacy(bytes.substr(2*word, bytes.size() - 3*word));
+        legacy.seekp(0, std::ios::end);
+        legacy.write((char*)&marker, word);
+        back.read(legacy);
+        if(!legacy.read((char*)&read_marker, word) || read_marker != marker || !back.hasLabel(5, 2) || !back.hasLabel(9, 4))
+            return 0;
+        std::size_t newer = GraphLabelContainer::FORMAT_VERSION + 1;
+        bytes.replace(word, word, (const char*)&newer, word);
+        std::stringstream future(bytes);
+        back.read(future);
+        if(future || back.size())
+            return 0;
+    }
+    LabelDelta delta;
+    GraphLabelContainer plain;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+        plain.setLabels(gv, model[gv]);
+    std::size_t labeled = num_entities - std::count(model.begin()+1, model.end(), std::vector<std::size_t>());
+    if(GraphLabelContainer::diff(plain, glc, delta) || GraphLabelContainer::diff(GraphLabelContainer(), glc, delta) != labeled)
+        return 0;
+    GraphLabelContainer patched;
+    patched.setTuplePolicy(policy);
+    patched.apply(delta);
+    if(!check_labels(patched, model, num_labels) || !patched.adaptTuples() || !check_labels(patched, model, num_labels))
+        return 0;
+    // a delta applied to a container with posting labels
+    std::vector<std::vector<std::size_t>> changed_model(model);
+    for(std::size_t gv = 7; gv <= num_entities; gv += 7)
+        changed_model[gv] = (gv % 49) ? std::vector<std::size_t>{1 + gv % 4, 5 + gv % (num_labels-4)} : std::vector<std::size_t>();
+    GraphLabelContainer changed;
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+        changed.setLabels(gv, changed_model[gv]);
+    std::size_t num_changed = GraphLabelContainer::diff(patched, changed, delta);
+    if(!num_changed || !patched.getTupleStats().posting_labels || patched.apply(delta) != num_changed ||
+       !check_labels(patched, changed_model, num_labels) || GraphLabelContainer::diff(patched, changed, delta))
+        return 0;
+    // back to the tuples
+    policy.adaptive = false;
+    glc.setTuplePolicy(policy);
+    for(std::size_t l = 1; l <= num_labels; ++l)
+        glc.setPostingLabel(l, false);
+    stats = glc.getTupleStats();
+    out << "restored tuples " << stats.tuples << " ratio " << stats.ratio << " memory " << glc.memory() << std::endl;
+    return !stats.posting_labels && stats.ratio > 0.5 && check_labels(glc, model, num_labels);
+}
+
+//! Compares a label projection of the entities gvs with getLabels
+bool check_projection(const GraphLabelContainer &glc, const std::vector<std::size_t> &gvs, const GraphLabelContainer::LabelProjection &projection)
+{
+    std::vector<std::size_t> labels;
+    if(projection.tuple_ids.size() != gvs.size() || projection.offsets.size() != gvs.size()+1 ||
+       projection.tuple_offsets.size() != projection.size_tuples()+1)
+        return false;
+    for(std::size_t i = 0; i < gvs.size(); ++i)
+    {
+        glc.getLabels(gvs[i], labels);
+        std::size_t t = projection.tuple_ids[i];
+        std::vector<std::size_t> tuple, expanded(projection.labels.begin() + projection.offsets[i], projection.labels.begin() + projection.offsets[i+1]);
+        if(t)
+            tuple.assign(projection.tuple_labels.begin() + projection.tuple_offsets[t-1], projection.tuple_labels.begin() + projection.tuple_offsets[t]);
+        if(t > projection.size_tuples() || labels != tuple || labels != expanded)
+            return false;
+    }
+    return true;
+}
+
+int test_label_projection(std::ostream &out)
+{
+    GraphLabelContainer glc;
+    std::size_t num_entities = 200000, num_labels = 12;
+    std::srand(61);
+    for(std::size_t gv = 1; gv <= num_entities; ++gv)
+    {
+        if(gv % 97 == 0)
+            continue;
+        glc.addLabel(gv, 1 + std::rand() % 3);
+        glc.addLabel(gv, 4 + std::rand() % (num_labels-3));
+    }
+    // a traversal result: random entities with repeats, unlabeled and unknown ones
+    std::vector<std::size_t> gvs(100000);
+    for(auto &gv : gvs)
+        gv = 1 + std::rand() % (num_entities + 100);
+    GraphLabelContainer::LabelProjection projection;
+    auto start = std::chrono::steady_clock::now();
+    std::size_t num_tuples = glc.projectLabels(gvs, projection);
+    double batch = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<std::size_t> labels;
+    std::size_t total = 0;
+    start = std::chrono::steady_clock::now();
+    for(auto gv : gvs)
+        total += glc.getLabels(gv, labels);
+    double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    out << "projected " << gvs.size() << " entities onto " << num_tuples << " tuples in " << batch << " s (getLabels loop "
+        << single << " s)" << std::endl;
+    if(num_tuples != projection.pair_indexes.size() || num_tuples > 3*(num_labels-3) || !projection.offsets.empty())
+        return 0;
+    glc.projectLabels(gvs, projection, true);
+    if(projection.labels.size() != total || !check_projection(glc, gvs, projection))
+        return 0;
+    // a small batch only pays for its own tuples
+    std::vector<std::size_t> few(gvs.begin(), gvs.begin() + 3);
+    few.push_back(few[0]);
+    if(glc.projectLabels(few, projection, true) > 3 || !check_projection(glc, few, projection))
+        return 0;
+    // intervals and posting labels
+    glc.compact(8);
+    glc.projectLabels(gvs, projection, true);
+    if(!check_projection(glc, gvs, projection))
+        return 0;
+    glc.setPostingLabel(5, true);
+    glc.projectLabels(gvs, projection, true);
+    if(!check_projection(glc, gvs, projection))
+        return 0;
+    // entities with several posting labels and with posting labels only share their tuples too
+    glc.setPostingLabel(6, true);
+    for(std::size_t gv = 1; gv <= num_entities; gv += 5)
+        glc.addLabel(gv, 6);
+    for(std::size_t gv = num_entities+1; gv <= num_entities+100; ++gv)
+        glc.addLabel(gv, gv % 2 ? 5 : 6);
+    num_tuples = glc.projectLabels(gvs, projection, true);
+    out << "tuples with posting labels " << num_tuples << std::endl;
+    if(num_tuples > 4*3*(num_labels-3) + 2 || !check_projection(glc, gvs, projection))
+        return 0;
+    return !glc.projectLabels(nullptr, 0, projection) && projection.tuple_ids.empty();
+}
+
 typedef std::map<std::string, int (*)(std::ostream&)> TestMapType;
 TestMapType tmap;
 
@@ -277,6 +1976,22 @@ int main(int c, char** v)
 {    
     REGISTER(test_A241_label_container)
     REGISTER(test_mimic_graph)
+    REGISTER(test_label_hierarchy)
+    REGISTER(test_label_cooccurrence)
+    REGISTER(test_entity_renumbering)
+    REGISTER(test_interval_tuples)
+    REGISTER(test_label_bitmaps)
+    REGISTER(test_batch_labels)
+    REGISTER(test_sorted_set_kernels)
+    REGISTER(test_standing_queries)
+    REGISTER(test_label_ingest)
+    REGISTER(test_chunked_file)
+    REGISTER(test_label_sampling)
+    REGISTER(test_label_path_index)
+    REGISTER(test_label_delta)
+    REGISTER(test_property_container)
+    REGISTER(test_adaptive_tuples)
+    REGISTER(test_label_projection)
     
     if(c == 1)
     {